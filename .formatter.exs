@@ -1,5 +1,5 @@
 # Used by "mix format"
 [
-  inputs: ["mix.exs", "{config,lib,test}/**/*.{ex,exs}"],
+  inputs: ["mix.exs", "{config,lib,test,bench}/**/*.{ex,exs}"],
   import_deps: [:stream_data]
 ]
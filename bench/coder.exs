@@ -0,0 +1,171 @@
+# Measures the cost of the key and value coders, needs no server.
+#
+#     mix run bench/coder.exs [--time 1] [--output path] [--compare path]
+#
+# Every shape is encoded, decoded and turned into a range (the `:first`
+# end of a partial key) with strings of 16, 256 and 4096 bytes, and
+# FDB.Coder.Compressed encodes and decodes JSON like values. Besides
+# the time, the memory allocated and the reductions per operation are
+# recorded. The results are written as JSON to
+# `bench/results/coder-<timestamp>.json`; pass an earlier file with
+# `--compare` to print the change of each measurement against it.
+
+alias FDB.Coder
+alias FDB.Versionstamp
+alias FDB.Transaction.Coder, as: TransactionCoder
+
+{opts, _, _} =
+  OptionParser.parse(System.argv(), strict: [time: :float, output: :string, compare: :string])
+
+time = Keyword.get(opts, :time, 1.0)
+output = Keyword.get(opts, :output, "bench/results/coder-#{System.os_time(:second)}.json")
+
+string = fn size -> String.duplicate("a", size) end
+versionstamp = Versionstamp.new(<<1::integer-size(80), 7::integer-size(16)>>)
+
+# {name, coder, sample key with strings of the given size, partial key}
+shapes = [
+  {"integer", Coder.Tuple.new({Coder.Integer.new(), Coder.Integer.new()}),
+   fn size -> {size, -size * 1_000_000} end, fn size -> {size} end},
+  {"byte_string", Coder.Tuple.new({Coder.ByteString.new(), Coder.ByteString.new()}),
+   fn size -> {string.(size), <<0, 1, 2>> <> string.(size)} end,
+   fn size -> {string.(size)} end},
+  {"unicode_string", Coder.Tuple.new({Coder.UnicodeString.new(), Coder.Integer.new()}),
+   fn size -> {String.duplicate("é", div(size, 2)), size} end,
+   fn size -> {String.duplicate("é", div(size, 2))} end},
+  {"nested_tuple",
+   Coder.Tuple.new(
+     {Coder.ByteString.new(),
+      Coder.NestedTuple.new({Coder.Integer.new(), Coder.UnicodeString.new()})}
+   ), fn size -> {string.(size), {size, string.(size)}} end, fn size -> {string.(size)} end},
+  {"versionstamp", Coder.Tuple.new({Coder.ByteString.new(), Coder.Versionstamp.new()}),
+   fn size -> {string.(size), versionstamp} end, fn size -> {string.(size)} end},
+  {"dynamic", Coder.Dynamic.new(),
+   fn size ->
+     {{:byte_string, string.(size)}, {:integer, size},
+      {:nested, {{:unicode_string, string.(size)}, {:versionstamp, versionstamp}}}}
+   end, fn size -> {{:byte_string, string.(size)}} end},
+  {"subspace",
+   Coder.Subspace.new(
+     {"bench", Coder.ByteString.new()},
+     Coder.Tuple.new({Coder.ByteString.new(), Coder.Integer.new()})
+   ), fn size -> {string.(size), size} end, fn size -> {string.(size)} end}
+]
+
+jobs =
+  for {name, coder, key, partial} <- shapes, size <- [16, 256, 4096] do
+    key = key.(size)
+    partial = partial.(size)
+    # the key shape is used as the value too
+    coder = TransactionCoder.new(coder, coder)
+    encoded = TransactionCoder.encode_key(coder, key)
+    name = "#{name} #{size}"
+
+    [
+      {"#{name} encode_key", fn -> TransactionCoder.encode_key(coder, key) end},
+      {"#{name} decode_key", fn -> TransactionCoder.decode_key(coder, encoded) end},
+      {"#{name} range", fn -> TransactionCoder.encode_range(coder, partial, :first) end},
+      {"#{name} encode_value", fn -> TransactionCoder.encode_value(coder, key) end},
+      {"#{name} decode_value", fn -> TransactionCoder.decode_value(coder, encoded) end}
+    ]
+  end
+  |> List.flatten()
+  |> Map.new()
+
+# the compressed coder is a value coder only
+dictionary = ~s({"name": "", "email": "", "created_at": "", "tags": []})
+json = fn i -> ~s({"name": "user#{i}", "email": "user#{i}@example.com", "tags": ["a", "b"]}) end
+
+compressed_jobs =
+  for {name, options} <- [
+        {"compressed", %{}},
+        {"compressed_dictionary", %{dictionaries: %{1 => dictionary}}}
+      ],
+      size <- [256, 4096] do
+    coder = Coder.Compressed.new(Coder.Identity.new(), Map.put(options, :threshold, 0))
+    value = Enum.map_join(1..div(size, 32), ",", json) |> binary_part(0, size)
+    encoded = coder.module.encode(value, coder.opts)
+
+    [
+      {"#{name} #{size} encode_value", fn -> coder.module.encode(value, coder.opts) end},
+      {"#{name} #{size} decode_value", fn -> coder.module.decode(encoded, coder.opts) end}
+    ]
+  end
+
+jobs = Map.merge(jobs, Map.new(List.flatten(compressed_jobs)))
+
+# Benchee 0.13 measures time and memory, the reductions are counted
+# here over a fixed number of calls, minus the cost of the loop.
+reductions = fn fun ->
+  count = 1000
+
+  loop = fn f ->
+    {:reductions, before} = Process.info(self(), :reductions)
+    Enum.each(1..count, fn _ -> f.() end)
+    {:reductions, after_loop} = Process.info(self(), :reductions)
+    after_loop - before
+  end
+
+  max(loop.(fun) - loop.(fn -> nil end), 0) / count
+end
+
+suite = Benchee.run(jobs, time: time, warmup: time / 2, memory_time: time / 2)
+
+results =
+  suite.scenarios
+  |> Enum.map(fn scenario ->
+    %{
+      name: scenario.job_name,
+      average_ns: scenario.run_time_statistics.average,
+      ips: scenario.run_time_statistics.ips,
+      memory_bytes: scenario.memory_usage_statistics.average,
+      reductions: reductions.(scenario.function)
+    }
+  end)
+  |> Enum.sort_by(& &1.name)
+
+report = %{
+  fdb_version: Mix.Project.config()[:version],
+  otp_release: to_string(:erlang.system_info(:otp_release)),
+  elixir_version: System.version(),
+  timestamp: DateTime.to_iso8601(DateTime.utc_now()),
+  results: results
+}
+
+File.mkdir_p!(Path.dirname(output))
+File.write!(output, Jason.encode_to_iodata!(report))
+IO.puts("Results written to #{output}")
+
+if path = Keyword.get(opts, :compare) do
+  previous =
+    File.read!(path)
+    |> Jason.decode!()
+    |> Map.fetch!("results")
+    |> Map.new(&{&1["name"], &1})
+
+  change = fn
+    new, old when new == nil or old in [nil, 0, 0.0] -> "-"
+    new, old ->
+      percent = Float.round((new - old) * 100 / old, 1)
+      if percent > 0, do: "+#{percent}%", else: "#{percent}%"
+  end
+
+  IO.puts("\nChange against #{path}\n")
+
+  :io.fwrite("~-40s ~10s ~10s ~10s~n", ['name', 'time', 'memory', 'reductions'])
+
+  Enum.each(results, fn result ->
+    case Map.fetch(previous, result.name) do
+      {:ok, old} ->
+        :io.fwrite("~-40s ~10s ~10s ~10s~n", [
+          result.name,
+          change.(result.average_ns, old["average_ns"]),
+          change.(result.memory_bytes, old["memory_bytes"]),
+          change.(result.reductions, old["reductions"])
+        ])
+
+      :error ->
+        :ok
+    end
+  end)
+end
@@ -0,0 +1,114 @@
+defmodule FDB.Bench.Histogram do
+  @moduledoc false
+
+  # A fixed size log-linear latency histogram in the spirit of
+  # HdrHistogram. Values below 128 are recorded exactly, larger values
+  # are recorded with 64 sub buckets per power of two, which keeps the
+  # relative error under 1.6%. The buckets are backed by `:counters`
+  # so multiple worker processes can record into the same histogram
+  # without any coordination.
+
+  use Bitwise
+
+  @linear 128
+  @sub_buckets 64
+  @max_exponent 34
+  @size @linear + @max_exponent * @sub_buckets
+  @max_value (1 <<< (@max_exponent + 7)) - 1
+
+  # extra slots at the end of the bucket array
+  @count @size + 1
+  @sum @size + 2
+
+  defstruct [:counters]
+
+  @type t :: %__MODULE__{counters: :counters.counters_ref()}
+
+  @spec new() :: t
+  def new do
+    %__MODULE__{counters: :counters.new(@size + 2, [:write_concurrency])}
+  end
+
+  @doc """
+  Records a single value, usually a latency in microseconds.
+  """
+  @spec record(t, non_neg_integer) :: :ok
+  def record(%__MODULE__{counters: counters}, value) when is_integer(value) and value >= 0 do
+    value = min(value, @max_value)
+    :ok = :counters.add(counters, index(value) + 1, 1)
+    :ok = :counters.add(counters, @count, 1)
+    :counters.add(counters, @sum, value)
+  end
+
+  @spec count(t) :: non_neg_integer
+  def count(%__MODULE__{counters: counters}), do: :counters.get(counters, @count)
+
+  @spec mean(t) :: float
+  def mean(%__MODULE__{counters: counters} = histogram) do
+    case count(histogram) do
+      0 -> 0.0
+      count -> :counters.get(counters, @sum) / count
+    end
+  end
+
+  @doc """
+  Returns the value at the given percentile. The returned value is the
+  highest value that is equivalent to the recorded one within the
+  precision of the histogram.
+  """
+  @spec percentile(t, number) :: non_neg_integer
+  def percentile(%__MODULE__{counters: counters} = histogram, percentile)
+      when percentile >= 0 and percentile <= 100 do
+    case count(histogram) do
+      0 ->
+        0
+
+      count ->
+        target = max(1, Float.ceil(percentile / 100 * count) |> trunc())
+        walk(counters, 0, 0, target)
+    end
+  end
+
+  @spec summary(t) :: map
+  def summary(histogram) do
+    %{
+      count: count(histogram),
+      mean: Float.round(mean(histogram), 3),
+      p50: percentile(histogram, 50),
+      p99: percentile(histogram, 99),
+      p999: percentile(histogram, 99.9),
+      max: percentile(histogram, 100)
+    }
+  end
+
+  defp walk(_counters, index, _acc, _target) when index >= @size, do: highest_equivalent(@size - 1)
+
+  defp walk(counters, index, acc, target) do
+    acc = acc + :counters.get(counters, index + 1)
+
+    if acc >= target do
+      highest_equivalent(index)
+    else
+      walk(counters, index + 1, acc, target)
+    end
+  end
+
+  defp index(value) when value < @linear, do: value
+
+  defp index(value) do
+    exponent = msb(value, 0) - 6
+    sub = (value >>> exponent) - @sub_buckets
+    @linear + (exponent - 1) * @sub_buckets + sub
+  end
+
+  defp highest_equivalent(index) when index < @linear, do: index
+
+  defp highest_equivalent(index) do
+    exponent = div(index - @linear, @sub_buckets) + 1
+    sub = rem(index - @linear, @sub_buckets)
+    ((sub + @sub_buckets) <<< exponent) + (1 <<< exponent) - 1
+  end
+
+  defp msb(1, acc), do: acc
+  defp msb(value, acc), do: msb(value >>> 1, acc + 1)
+end
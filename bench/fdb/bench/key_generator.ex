@@ -0,0 +1,102 @@
+defmodule FDB.Bench.KeyGenerator do
+  @moduledoc false
+
+  # Key choosers used by the YCSB workloads. The zipfian generator
+  # follows the algorithm used by YCSB (Gray et al, "Quickly
+  # Generating Billion-Record Synthetic Databases"). The scrambled
+  # variant hashes the generated rank so that the popular keys are
+  # spread across the key space instead of being clustered at the
+  # start of it.
+
+  use Bitwise
+
+  @theta 0.99
+  @fnv_offset 0xCBF29CE484222325
+  @fnv_prime 0x100000001B3
+  @mask64 0xFFFFFFFFFFFFFFFF
+
+  defstruct [:distribution, :items, :zipfian, :inserted]
+
+  @type distribution :: :uniform | :zipfian | :latest
+  @type t :: %__MODULE__{}
+
+  @doc """
+  `inserted` is an `:atomics` reference which holds the number of keys
+  inserted so far. It is shared with the insert operations so that
+  `:latest` can follow the inserts.
+  """
+  @spec new(distribution, pos_integer, :atomics.atomics_ref()) :: t
+  def new(distribution, items, inserted) when distribution in [:uniform, :zipfian, :latest] do
+    zipfian =
+      if distribution in [:zipfian, :latest] do
+        zipfian(items)
+      end
+
+    %__MODULE__{distribution: distribution, items: items, zipfian: zipfian, inserted: inserted}
+  end
+
+  @doc """
+  Returns the id of an existing key.
+  """
+  @spec next(t) :: non_neg_integer
+  def next(%__MODULE__{distribution: :uniform, inserted: inserted}) do
+    :rand.uniform(:atomics.get(inserted, 1)) - 1
+  end
+
+  def next(%__MODULE__{distribution: :zipfian, zipfian: zipfian, inserted: inserted}) do
+    count = :atomics.get(inserted, 1)
+    rem(fnv(next_zipfian(zipfian)), count)
+  end
+
+  def next(%__MODULE__{distribution: :latest, zipfian: zipfian, inserted: inserted}) do
+    count = :atomics.get(inserted, 1)
+    max(count - 1 - next_zipfian(zipfian), 0)
+  end
+
+  @doc """
+  Reserves the id for a new key.
+  """
+  @spec insert(t) :: non_neg_integer
+  def insert(%__MODULE__{inserted: inserted}) do
+    :atomics.add_get(inserted, 1, 1) - 1
+  end
+
+  defp zipfian(items) do
+    zetan = zeta(items, @theta)
+    zeta2 = zeta(2, @theta)
+
+    %{
+      items: items,
+      zetan: zetan,
+      alpha: 1.0 / (1.0 - @theta),
+      eta: (1 - :math.pow(2.0 / items, 1 - @theta)) / (1 - zeta2 / zetan),
+      half_pow_theta: 1 + :math.pow(0.5, @theta)
+    }
+  end
+
+  defp next_zipfian(z) do
+    u = :rand.uniform()
+    uz = u * z.zetan
+
+    cond do
+      uz < 1.0 ->
+        0
+
+      uz < z.half_pow_theta ->
+        1
+
+      true ->
+        trunc(z.items * :math.pow(z.eta * u - z.eta + 1, z.alpha))
+    end
+  end
+
+  defp zeta(n, theta) do
+    Enum.reduce(1..n, 0.0, fn i, acc -> acc + 1 / :math.pow(i, theta) end)
+  end
+
+  defp fnv(value) do
+    for <<byte <- <<value::unsigned-little-integer-size(64)>> >>, reduce: @fnv_offset do
+      hash -> (bxor(hash, byte) * @fnv_prime) &&& @mask64
+    end
+  end
+end
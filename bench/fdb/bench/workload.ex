@@ -0,0 +1,175 @@
+defmodule FDB.Bench.Workload do
+  @moduledoc false
+
+  # YCSB core workloads A-F plus a pure range scan workload. Refer
+  # https://github.com/brianfrankcooper/YCSB/wiki/Core-Workloads
+
+  alias FDB.{Database, Transaction, KeySelector, KeySelectorRange}
+  alias FDB.Bench.{Histogram, KeyGenerator}
+
+  defstruct [:name, :mix, :distribution, :description]
+
+  @type operation :: :read | :update | :insert | :scan | :read_modify_write
+  @type t :: %__MODULE__{
+          name: String.t(),
+          mix: [{operation, float}],
+          distribution: KeyGenerator.distribution(),
+          description: String.t()
+        }
+
+  @workloads %{
+    "a" => {"update heavy", [read: 0.5, update: 0.5], :zipfian},
+    "b" => {"read mostly", [read: 0.95, update: 0.05], :zipfian},
+    "c" => {"read only", [read: 1.0], :zipfian},
+    "d" => {"read latest", [read: 0.95, insert: 0.05], :latest},
+    "e" => {"short ranges", [scan: 0.95, insert: 0.05], :zipfian},
+    "f" => {"read-modify-write", [read: 0.5, read_modify_write: 0.5], :zipfian},
+    "scan" => {"range scan only", [scan: 1.0], :uniform}
+  }
+
+  @spec names() :: [String.t()]
+  def names, do: ["a", "b", "c", "d", "e", "f", "scan"]
+
+  @spec get!(String.t(), KeyGenerator.distribution() | nil) :: t
+  def get!(name, distribution \\ nil) do
+    case Map.fetch(@workloads, name) do
+      {:ok, {description, mix, default_distribution}} ->
+        %__MODULE__{
+          name: name,
+          mix: mix,
+          distribution: distribution || default_distribution,
+          description: description
+        }
+
+      :error ->
+        raise ArgumentError,
+              "Unknown workload #{inspect(name)}, expected one of #{Enum.join(names(), ", ")}"
+    end
+  end
+
+  @doc """
+  Runs the workload with `config.concurrency` workers for
+  `config.duration` seconds and returns the latency histograms per
+  operation.
+  """
+  @spec run(t, Database.t(), map) :: map
+  def run(%__MODULE__{} = workload, db, config) do
+    generator = KeyGenerator.new(workload.distribution, config.records, config.inserted)
+    histograms = Map.new([:all | Keyword.keys(workload.mix)], &{&1, Histogram.new()})
+    deadline = System.monotonic_time(:millisecond) + config.duration * 1000
+
+    started = System.monotonic_time(:microsecond)
+
+    1..config.concurrency
+    |> Enum.map(fn _ ->
+      Task.async(fn -> worker(workload, db, config, generator, histograms, deadline) end)
+    end)
+    |> Enum.each(&Task.await(&1, :infinity))
+
+    elapsed = System.monotonic_time(:microsecond) - started
+    operations = Histogram.count(histograms.all)
+
+    %{
+      workload: workload.name,
+      description: workload.description,
+      distribution: workload.distribution,
+      concurrency: config.concurrency,
+      elapsed_ms: div(elapsed, 1000),
+      operations: operations,
+      throughput: Float.round(operations / (elapsed / 1_000_000), 2),
+      latency_us: Map.new(histograms, fn {op, h} -> {op, Histogram.summary(h)} end)
+    }
+  end
+
+  defp worker(workload, db, config, generator, histograms, deadline) do
+    if System.monotonic_time(:millisecond) < deadline do
+      operation = choose(workload.mix, :rand.uniform())
+      start = System.monotonic_time(:microsecond)
+      execute(operation, db, config, generator)
+      latency = System.monotonic_time(:microsecond) - start
+
+      :ok = Histogram.record(Map.fetch!(histograms, operation), latency)
+      :ok = Histogram.record(histograms.all, latency)
+      worker(workload, db, config, generator, histograms, deadline)
+    else
+      :ok
+    end
+  end
+
+  defp choose([{operation, _}], _), do: operation
+
+  defp choose([{operation, probability} | rest], random) do
+    if random <= probability do
+      operation
+    else
+      choose(rest, random - probability)
+    end
+  end
+
+  defp execute(:read, db, _config, generator) do
+    id = KeyGenerator.next(generator)
+    Database.transact(db, fn t -> Transaction.get(t, key(id)) end)
+  end
+
+  defp execute(:update, db, config, generator) do
+    id = KeyGenerator.next(generator)
+    Database.transact(db, fn t -> Transaction.set(t, key(id), random_value(config)) end)
+  end
+
+  defp execute(:insert, db, config, generator) do
+    id = KeyGenerator.insert(generator)
+    Database.transact(db, fn t -> Transaction.set(t, key(id), random_value(config)) end)
+  end
+
+  defp execute(:scan, db, config, generator) do
+    id = KeyGenerator.next(generator)
+    length = :rand.uniform(config.scan_length)
+
+    range =
+      KeySelectorRange.range(
+        KeySelector.first_greater_or_equal(key(id)),
+        KeySelector.first_greater_or_equal(nil, %{prefix: :last})
+      )
+
+    Database.transact(db, fn t ->
+      Transaction.get_range(t, range, %{limit: length, mode: FDB.Option.streaming_mode_exact()})
+    end)
+  end
+
+  defp execute(:read_modify_write, db, config, generator) do
+    id = KeyGenerator.next(generator)
+
+    Database.transact(db, fn t ->
+      _ = Transaction.get(t, key(id))
+      Transaction.set(t, key(id), random_value(config))
+    end)
+  end
+
+  @doc """
+  Populates the key space with `config.records` keys.
+  """
+  @spec load(Database.t(), map) :: :ok
+  def load(db, config) do
+    0..(config.records - 1)
+    |> Stream.chunk_every(100)
+    |> Task.async_stream(
+      fn ids ->
+        Database.transact(db, fn t ->
+          Enum.each(ids, &Transaction.set(t, key(&1), random_value(config)))
+        end)
+      end,
+      max_concurrency: config.concurrency,
+      timeout: :infinity
+    )
+    |> Stream.run()
+
+    :atomics.put(config.inserted, 1, config.records)
+  end
+
+  @spec key(non_neg_integer) :: tuple
+  def key(id), do: {"usertable", id}
+
+  defp random_value(%{values: values}) do
+    elem(values, :rand.uniform(tuple_size(values)) - 1)
+  end
+end
@@ -0,0 +1,200 @@
+defmodule Mix.Tasks.Fdb.Bench do
+  use Mix.Task
+
+  @shortdoc "Runs YCSB style workloads against a local fdbserver"
+
+  @moduledoc """
+  Runs the [YCSB core
+  workloads](https://github.com/brianfrankcooper/YCSB/wiki/Core-Workloads)
+  against a FoundationDB cluster and records the latency of each
+  operation in a histogram.
+
+  The benchmark is meant to be run against a throwaway local server,
+  for example the one started by `make start-server`. Only the keys
+  under the `fdb_bench` prefix are touched.
+
+      mix fdb.bench --workloads a,c,e --records 100000 --duration 30
+
+  The results are printed as a table and written as JSON, so that runs
+  on different commits can be compared.
+
+  ## Options
+
+  * `--workloads` - comma separated list of workloads. One of `a`,
+    `b`, `c`, `d`, `e`, `f` and `scan`. Defaults to all.
+  * `--distribution` - overrides the key distribution of the
+    workloads. One of `uniform`, `zipfian` and `latest`.
+  * `--records` - number of records loaded before running the
+    workloads. Defaults to `100000`.
+  * `--duration` - duration of each workload in seconds. Defaults to `10`.
+  * `--concurrency` - number of concurrent clients. Defaults to `16`.
+  * `--value-size` - size of the value in bytes, either a single value
+    like `100` or a range like `100..1000`. Defaults to `100`.
+  * `--scan-length` - maximum number of keys read by a scan. Defaults to `100`.
+  * `--cluster-file` - path of the cluster file. Defaults to the
+    default cluster file.
+  * `--output` - path of the JSON result file. Defaults to
+    `bench/results/ycsb-<timestamp>.json`.
+  * `--skip-load` - reuse the records loaded by a previous run.
+  """
+
+  alias FDB.{Database, Transaction, KeyRange}
+  alias FDB.Coder.{Subspace, Tuple, ByteString, Integer, Identity}
+  alias FDB.Bench.Workload
+
+  @switches [
+    workloads: :string,
+    distribution: :string,
+    records: :integer,
+    duration: :integer,
+    concurrency: :integer,
+    value_size: :string,
+    scan_length: :integer,
+    cluster_file: :string,
+    output: :string,
+    skip_load: :boolean
+  ]
+
+  @impl true
+  def run(args) do
+    {opts, _, _} = OptionParser.parse(args, strict: @switches)
+    Mix.Task.run("app.start")
+
+    config = config(opts)
+    workloads = Enum.map(config.workloads, &Workload.get!(&1, config.distribution))
+
+    :ok = FDB.start()
+
+    coder =
+      Transaction.Coder.new(
+        Subspace.new("fdb_bench", Tuple.new({ByteString.new(), Integer.new()})),
+        Identity.new()
+      )
+
+    db = Database.create(config.cluster_file, %{coder: coder})
+
+    if config.skip_load do
+      :atomics.put(config.inserted, 1, config.records)
+    else
+      Mix.shell().info("Loading #{config.records} records")
+
+      Database.transact(db, fn t ->
+        Transaction.clear_range(t, KeyRange.starts_with(nil))
+      end)
+
+      :ok = Workload.load(db, config)
+    end
+
+    results =
+      Enum.map(workloads, fn workload ->
+        Mix.shell().info("Running workload #{workload.name} (#{workload.description})")
+        Workload.run(workload, db, config)
+      end)
+
+    print(results)
+    write(config, results)
+  end
+
+  defp config(opts) do
+    {min_size, max_size} = parse_value_size(Keyword.get(opts, :value_size, "100"))
+
+    values =
+      Enum.map(1..1000, fn _ ->
+        :crypto.strong_rand_bytes(Enum.random(min_size..max_size))
+      end)
+
+    workloads = Keyword.get(opts, :workloads, Enum.join(Workload.names(), ","))
+
+    %{
+      workloads: String.split(workloads, ","),
+      distribution: parse_distribution(Keyword.get(opts, :distribution)),
+      records: Keyword.get(opts, :records, 100_000),
+      duration: Keyword.get(opts, :duration, 10),
+      concurrency: Keyword.get(opts, :concurrency, 16),
+      value_size: %{min: min_size, max: max_size},
+      scan_length: Keyword.get(opts, :scan_length, 100),
+      cluster_file: Keyword.get(opts, :cluster_file),
+      output: Keyword.get(opts, :output, "bench/results/ycsb-#{System.os_time(:second)}.json"),
+      skip_load: Keyword.get(opts, :skip_load, false),
+      inserted: :atomics.new(1, []),
+      values: List.to_tuple(values)
+    }
+  end
+
+  defp parse_value_size(size) do
+    case String.split(size, "..") do
+      [size] -> {String.to_integer(size), String.to_integer(size)}
+      [min, max] -> {String.to_integer(min), String.to_integer(max)}
+    end
+  end
+
+  defp parse_distribution(nil), do: nil
+  defp parse_distribution("uniform"), do: :uniform
+  defp parse_distribution("zipfian"), do: :zipfian
+  defp parse_distribution("latest"), do: :latest
+
+  defp parse_distribution(other),
+    do: Mix.raise("Unknown distribution #{inspect(other)}, expected uniform, zipfian or latest")
+
+  defp print(results) do
+    pattern = "~*s~*s~*s~*s~*s~*s~*s~*s\n"
+    widths = [10, 20, 13, 12, 10, 10, 10, 10]
+
+    row(pattern, widths, [
+      "workload",
+      "operation",
+      "concurrency",
+      "ops/s",
+      "p50 us",
+      "p99 us",
+      "p999 us",
+      "max us"
+    ])
+
+    Enum.each(results, fn result ->
+      Enum.each(Enum.sort(result.latency_us), fn {operation, latency} ->
+        ops =
+          if operation == :all do
+            to_string(trunc(result.throughput))
+          else
+            ""
+          end
+
+        row(pattern, widths, [
+          result.workload,
+          to_string(operation),
+          to_string(result.concurrency),
+          ops,
+          to_string(latency.p50),
+          to_string(latency.p99),
+          to_string(latency.p999),
+          to_string(latency.max)
+        ])
+      end)
+    end)
+  end
+
+  defp row(pattern, widths, values) do
+    args =
+      Enum.zip(widths, values)
+      |> Enum.flat_map(fn {width, value} -> [width, to_charlist(value)] end)
+
+    :io.fwrite(pattern, args)
+  end
+
+  defp write(config, results) do
+    report = %{
+      fdb_version: Mix.Project.config()[:version],
+      otp_release: to_string(:erlang.system_info(:otp_release)),
+      elixir_version: System.version(),
+      schedulers: System.schedulers_online(),
+      timestamp: DateTime.to_iso8601(DateTime.utc_now()),
+      config: Map.drop(config, [:inserted, :values, :output, :skip_load, :workloads]),
+      results: results
+    }
+
+    File.mkdir_p!(Path.dirname(config.output))
+    File.write!(config.output, Jason.encode_to_iodata!(report))
+    Mix.shell().info("Results written to #{config.output}")
+  end
+end
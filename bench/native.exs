@@ -0,0 +1,56 @@
+# Measures the per operation cost of the bindings (nif, futures and
+# coders) without a cluster. Build the nif against the in-memory
+# stand-in first:
+#
+#     make clean && FDB_FAKE=1 mix run bench/native.exs
+#
+# Run `make clean` again afterwards to link against libfdb_c.
+
+alias FDB.{Database, Transaction, KeySelectorRange}
+alias FDB.Coder.{Subspace, Tuple, ByteString, Integer, Identity}
+
+:ok = FDB.start()
+
+raw = Database.create()
+
+coder =
+  Transaction.Coder.new(
+    Subspace.new("fdb_native", Tuple.new({ByteString.new(), Integer.new()})),
+    Identity.new()
+  )
+
+db = Database.create(nil, %{coder: coder})
+value = :crypto.strong_rand_bytes(100)
+
+Database.transact(db, fn t ->
+  Enum.each(1..1000, &Transaction.set(t, {"key", &1}, value))
+end)
+
+t = Transaction.create(db)
+raw_t = Transaction.create(raw)
+
+Benchee.run(
+  %{
+    "get raw" => fn -> Transaction.get(raw_t, "fdb_native") end,
+    "get tuple" => fn -> Transaction.get(t, {"key", 500}) end,
+    "get_q x 10" => fn ->
+      Enum.map(1..10, &Transaction.get_q(t, {"key", &1}))
+      |> FDB.Future.all()
+      |> FDB.Future.await()
+    end,
+    "set" =>
+      {fn t -> Transaction.set(t, {"scratch", 1}, value) end,
+       before_each: fn _ -> Transaction.create(db) end},
+    "get_range 100" => fn ->
+      Transaction.get_range(t, KeySelectorRange.starts_with({"key"}), %{limit: 100}).key_values
+    end,
+    "transact set" => fn ->
+      Database.transact(db, fn t -> Transaction.set(t, {"scratch", 2}, value) end)
+    end,
+    "transact read only" => fn ->
+      Database.transact(db, fn t -> Transaction.get(t, {"key", 1}) end)
+    end
+  },
+  time: 5,
+  warmup: 1
+)
@@ -0,0 +1,70 @@
+# Measures the throughput of FDB.Queue against the number of
+# consumers. Needs a throwaway local server, see `make start-server`.
+#
+#     mix run bench/queue.exs [items] [batch_size]
+#
+# For each consumer count, `items` items are pushed by 4 producers
+# while the consumers drain the queue, acking each batch along with
+# the claim of the next one.
+
+alias FDB.{Database, Transaction, Queue}
+
+{items, batch_size} =
+  case System.argv() do
+    [items, batch_size] -> {String.to_integer(items), String.to_integer(batch_size)}
+    [items] -> {String.to_integer(items), 100}
+    [] -> {20_000, 100}
+  end
+
+:ok = FDB.start()
+db = Database.create()
+queue = Queue.new("fdb_bench_queue")
+value = :crypto.strong_rand_bytes(100)
+producers = 4
+push_batch = 10
+
+reset = fn ->
+  Database.transact(db, fn t ->
+    Transaction.clear_range(t, FDB.KeyRange.starts_with("fdb_bench_queue"))
+  end)
+end
+
+IO.puts("consumers\titems/s\tunclaimed")
+
+for consumers <- [1, 2, 4, 8, 16, 32] do
+  reset.()
+  counter = :counters.new(1, [])
+  started = System.monotonic_time(:microsecond)
+
+  producer_tasks =
+    Enum.map(1..producers, fn _ ->
+      Task.async(fn ->
+        Enum.each(1..div(items, producers * push_batch), fn _ ->
+          Database.transact(db, fn t ->
+            Queue.push_all(t, queue, List.duplicate(value, push_batch))
+          end)
+        end)
+      end)
+    end)
+
+  consume = fn consume, acks ->
+    if :counters.get(counter, 1) >= items do
+      Queue.ack(db, queue, acks)
+    else
+      claimed = Queue.claim(db, queue, batch_size, %{ack: acks, timeout: 100})
+      :counters.add(counter, 1, length(claimed))
+      consume.(consume, Enum.map(claimed, & &1.id))
+    end
+  end
+
+  consumer_tasks = Enum.map(1..consumers, fn _ -> Task.async(fn -> consume.(consume, []) end) end)
+
+  Enum.each(producer_tasks, &Task.await(&1, :infinity))
+  Enum.each(consumer_tasks, &Task.await(&1, :infinity))
+
+  elapsed = System.monotonic_time(:microsecond) - started
+  consumed = :counters.get(counter, 1)
+  throughput = Float.round(consumed / (elapsed / 1_000_000), 1)
+
+  IO.puts("#{consumers}\t\t#{throughput}\t#{Queue.size(db, queue)}")
+end
@@ -0,0 +1,1876 @@
+/* An in-process stand-in for libfdb_c, used to measure the overhead of
+ * the nif, futures and coders without a cluster.
+ *
+ * All the databases share a single in-memory ordered map. Reads are
+ * evaluated when the operation is issued, but the futures are only
+ * marked ready by the network thread started with fdb_run_network,
+ * so the callback path is the same as with the real client. There is
+ * no conflict detection, every commit succeeds unless the transaction
+ * was cancelled, timed out or exceeded the size limit.
+ *
+ * This is a test only library and it is not compiled unless FDB_FAKE
+ * is set, see the Makefile.
+ */
+
+#include "foundationdb/fdb_c.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define API_VERSION 710
+
+#define ERROR_TIMED_OUT 1031
+#define ERROR_TRANSACTION_CANCELLED 1025
+#define ERROR_NOT_COMMITTED 1020
+#define ERROR_CLIENT_INVALID_OPERATION 2000
+#define ERROR_KEY_OUTSIDE_LEGAL_RANGE 2004
+#define ERROR_INVERTED_RANGE 2005
+#define ERROR_NETWORK_ALREADY_SETUP 2009
+#define ERROR_USED_DURING_COMMIT 2017
+#define ERROR_NO_COMMIT_VERSION 2021
+#define ERROR_TRANSACTION_TOO_LARGE 2101
+#define ERROR_UNSUPPORTED_OPERATION 2108
+#define ERROR_API_VERSION_ALREADY_SET 2201
+#define ERROR_API_VERSION_INVALID 2202
+#define ERROR_NO_CLUSTER_FILE_FOUND 1515
+
+#define OPTION_TIMEOUT 500
+#define OPTION_RETRY_LIMIT 501
+#define OPTION_SIZE_LIMIT 503
+#define OPTION_ACCESS_SYSTEM_KEYS 301
+#define OPTION_READ_SYSTEM_KEYS 302
+
+#define PREDICATE_RETRYABLE 50000
+#define PREDICATE_MAYBE_COMMITTED 50001
+#define PREDICATE_RETRYABLE_NOT_COMMITTED 50002
+
+#define DEFAULT_SIZE_LIMIT 10000000
+#define VALUE_SIZE_LIMIT 100000
+
+static const uint8_t END_KEY[] = {0xFF};
+static const uint8_t SYSTEM_END_KEY[] = {0xFF, 0xFF};
+
+static int64_t
+now_ms(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static uint8_t *
+copy_bytes(uint8_t const *data, int length) {
+  uint8_t *copy = malloc(length > 0 ? length : 1);
+  if (length > 0) {
+    memcpy(copy, data, length);
+  }
+  return copy;
+}
+
+static int
+compare_bytes(uint8_t const *a, int a_length, uint8_t const *b, int b_length) {
+  int min = a_length < b_length ? a_length : b_length;
+  int result = min > 0 ? memcmp(a, b, min) : 0;
+  if (result != 0) {
+    return result;
+  }
+  return a_length - b_length;
+}
+
+/* Ordered table, used both for the store and for the writes buffered
+ * in a transaction. present is 0 for keys cleared by a transaction. */
+
+typedef struct {
+  uint8_t *key;
+  int key_length;
+  uint8_t *value;
+  int value_length;
+  int present;
+} Entry;
+
+typedef struct {
+  Entry *entries;
+  int count;
+  int capacity;
+} Table;
+
+static int
+table_lower_bound(Table *table, uint8_t const *key, int key_length) {
+  int low = 0;
+  int high = table->count;
+  while (low < high) {
+    int mid = low + (high - low) / 2;
+    Entry *entry = &table->entries[mid];
+    if (compare_bytes(entry->key, entry->key_length, key, key_length) < 0) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+  return low;
+}
+
+static Entry *
+table_find(Table *table, uint8_t const *key, int key_length) {
+  int i = table_lower_bound(table, key, key_length);
+  if (i < table->count &&
+      compare_bytes(table->entries[i].key, table->entries[i].key_length, key,
+                    key_length) == 0) {
+    return &table->entries[i];
+  }
+  return NULL;
+}
+
+static void
+table_put(Table *table, uint8_t const *key, int key_length,
+          uint8_t const *value, int value_length, int present) {
+  int i = table_lower_bound(table, key, key_length);
+  Entry *entry;
+
+  if (i < table->count &&
+      compare_bytes(table->entries[i].key, table->entries[i].key_length, key,
+                    key_length) == 0) {
+    entry = &table->entries[i];
+    free(entry->value);
+  } else {
+    if (table->count == table->capacity) {
+      table->capacity = table->capacity ? table->capacity * 2 : 16;
+      table->entries = realloc(table->entries, sizeof(Entry) * table->capacity);
+    }
+    memmove(&table->entries[i + 1], &table->entries[i],
+            sizeof(Entry) * (table->count - i));
+    table->count++;
+    entry = &table->entries[i];
+    entry->key = copy_bytes(key, key_length);
+    entry->key_length = key_length;
+  }
+
+  entry->value = copy_bytes(value, value_length);
+  entry->value_length = value_length;
+  entry->present = present;
+}
+
+static void
+table_erase(Table *table, int from, int to) {
+  int i;
+  if (from >= to) {
+    return;
+  }
+  for (i = from; i < to; i++) {
+    free(table->entries[i].key);
+    free(table->entries[i].value);
+  }
+  memmove(&table->entries[from], &table->entries[to],
+          sizeof(Entry) * (table->count - to));
+  table->count -= to - from;
+}
+
+static void
+table_clear_range(Table *table, uint8_t const *begin, int begin_length,
+                  uint8_t const *end, int end_length) {
+  table_erase(table, table_lower_bound(table, begin, begin_length),
+              table_lower_bound(table, end, end_length));
+}
+
+static void
+table_destroy(Table *table) {
+  table_erase(table, 0, table->count);
+  free(table->entries);
+  table->entries = NULL;
+  table->capacity = 0;
+}
+
+/* Futures */
+
+typedef enum {
+  FUTURE_EMPTY,
+  FUTURE_INT64,
+  FUTURE_KEY,
+  FUTURE_VALUE,
+  FUTURE_KEYVALUE_ARRAY,
+  FUTURE_KEY_ARRAY,
+  FUTURE_STRING_ARRAY
+} FutureType;
+
+struct FDB_future {
+  FutureType type;
+  int ready;
+  int references;
+  fdb_error_t error;
+  FDBCallback callback;
+  void *callback_parameter;
+
+  int64_t int64;
+  fdb_bool_t present;
+  uint8_t *bytes;
+  int bytes_length;
+  FDBKeyValue *key_values;
+  FDBKey *keys;
+  int count;
+  fdb_bool_t more;
+
+  /* watch */
+  uint8_t *watch_key;
+  int watch_key_length;
+  struct FDB_future *next_watch;
+
+  struct FDB_future *next;
+};
+
+static pthread_mutex_t future_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t future_ready = PTHREAD_COND_INITIALIZER;
+
+static pthread_mutex_t network_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t network_signal = PTHREAD_COND_INITIALIZER;
+static FDBFuture *network_head = NULL;
+static FDBFuture *network_tail = NULL;
+static int network_setup = 0;
+static int network_stopped = 0;
+static int selected_api_version = 0;
+
+static const char *addresses[] = {"127.0.0.1:4500"};
+
+static FDBFuture *
+future_create(FutureType type) {
+  FDBFuture *future = calloc(1, sizeof(FDBFuture));
+  future->type = type;
+  future->references = 1;
+  return future;
+}
+
+static void
+future_free(FDBFuture *future) {
+  int i;
+  free(future->bytes);
+  for (i = 0; future->key_values && i < future->count; i++) {
+    free((void *)future->key_values[i].key);
+    free((void *)future->key_values[i].value);
+  }
+  free(future->key_values);
+  for (i = 0; future->keys && i < future->count; i++) {
+    free((void *)future->keys[i].key);
+  }
+  free(future->keys);
+  free(future->watch_key);
+  free(future);
+}
+
+static void
+future_release(FDBFuture *future) {
+  int references;
+  pthread_mutex_lock(&future_lock);
+  references = --future->references;
+  pthread_mutex_unlock(&future_lock);
+  if (references == 0) {
+    future_free(future);
+  }
+}
+
+/* Hands the future over to the network thread, which marks it ready
+ * and invokes the callback. */
+static FDBFuture *
+future_schedule(FDBFuture *future) {
+  pthread_mutex_lock(&future_lock);
+  future->references++;
+  pthread_mutex_unlock(&future_lock);
+
+  pthread_mutex_lock(&network_lock);
+  future->next = NULL;
+  if (network_tail) {
+    network_tail->next = future;
+  } else {
+    network_head = future;
+  }
+  network_tail = future;
+  pthread_cond_signal(&network_signal);
+  pthread_mutex_unlock(&network_lock);
+  return future;
+}
+
+static FDBFuture *
+future_error(FutureType type, fdb_error_t error) {
+  FDBFuture *future = future_create(type);
+  future->error = error;
+  return future_schedule(future);
+}
+
+static void
+future_complete(FDBFuture *future) {
+  FDBCallback callback;
+  void *callback_parameter;
+
+  pthread_mutex_lock(&future_lock);
+  future->ready = 1;
+  callback = future->callback;
+  callback_parameter = future->callback_parameter;
+  future->callback = NULL;
+  pthread_cond_broadcast(&future_ready);
+  pthread_mutex_unlock(&future_lock);
+
+  if (callback) {
+    callback(future, callback_parameter);
+  }
+  future_release(future);
+}
+
+/* Store */
+
+typedef struct {
+  Table table;
+  int64_t version;
+  FDBFuture *watches;
+  pthread_rwlock_t lock;
+} Store;
+
+static Store global_store = {{NULL, 0, 0}, 1, NULL, PTHREAD_RWLOCK_INITIALIZER};
+
+struct FDB_database {
+  Store *store;
+};
+
+/* Each tenant gets a store of its own, created on first open, instead
+ * of a prefix of the global store. Tenants are never deleted. */
+typedef struct TenantStore {
+  uint8_t *name;
+  int name_length;
+  Store store;
+  struct TenantStore *next;
+} TenantStore;
+
+static TenantStore *tenant_stores = NULL;
+static pthread_mutex_t tenant_lock = PTHREAD_MUTEX_INITIALIZER;
+
+struct FDB_tenant {
+  Store *store;
+};
+
+typedef struct Mutation {
+  int type;
+  uint8_t *key;
+  int key_length;
+  uint8_t *param;
+  int param_length;
+  struct Mutation *next;
+} Mutation;
+
+#define MUTATION_SET -1
+#define MUTATION_CLEAR -2
+#define MUTATION_CLEAR_RANGE -3
+
+#define MUTATION_ADD 2
+#define MUTATION_AND 6
+#define MUTATION_OR 7
+#define MUTATION_XOR 8
+#define MUTATION_APPEND_IF_FITS 9
+#define MUTATION_MAX 12
+#define MUTATION_MIN 13
+#define MUTATION_SET_VERSIONSTAMPED_KEY 14
+#define MUTATION_SET_VERSIONSTAMPED_VALUE 15
+#define MUTATION_BYTE_MIN 16
+#define MUTATION_BYTE_MAX 17
+#define MUTATION_COMPARE_AND_CLEAR 20
+
+typedef struct {
+  uint8_t *begin;
+  int begin_length;
+  uint8_t *end;
+  int end_length;
+} Range;
+
+struct FDB_transaction {
+  Store *store;
+  pthread_mutex_t lock;
+
+  Table writes;
+  Range *clears;
+  int clear_count;
+  int clear_capacity;
+  Mutation *mutations;
+  Mutation *last_mutation;
+
+  int64_t read_version;
+  int64_t committed_version;
+  int64_t size;
+  int64_t size_limit;
+  int64_t timeout;
+  int64_t started_at;
+  int retry_limit;
+  int retries;
+  int system_keys;
+  int committing;
+  int cancelled;
+  fdb_error_t deferred_error;
+  FDBFuture **versionstamps;
+  int versionstamp_count;
+  int versionstamp_capacity;
+};
+
+/* Errors */
+
+const char *
+fdb_get_error(fdb_error_t code) {
+  switch (code) {
+  case 0:
+    return "Success";
+  case 1007:
+    return "Transaction is too old to perform reads or be committed";
+  case 1009:
+    return "Request for future version";
+  case ERROR_NOT_COMMITTED:
+    return "Transaction not committed due to conflict with another "
+           "transaction";
+  case 1021:
+    return "Transaction may or may not have committed";
+  case ERROR_TRANSACTION_CANCELLED:
+    return "Operation aborted because the transaction was cancelled";
+  case ERROR_TIMED_OUT:
+    return "Operation aborted because the transaction timed out";
+  case 1037:
+    return "Storage process does not have recent mutations";
+  case 1042:
+    return "Proxy commit memory limit exceeded";
+  case 1051:
+    return "Batch GRV request rate limit exceeded";
+  case 1213:
+    return "Transaction tag is being throttled";
+  case ERROR_NO_CLUSTER_FILE_FOUND:
+    return "No cluster file found in current directory or default location";
+  case ERROR_CLIENT_INVALID_OPERATION:
+    return "Invalid API call";
+  case ERROR_KEY_OUTSIDE_LEGAL_RANGE:
+    return "Key outside legal range";
+  case ERROR_INVERTED_RANGE:
+    return "Range begin key larger than end key";
+  case ERROR_NETWORK_ALREADY_SETUP:
+    return "Network can be configured only once";
+  case ERROR_USED_DURING_COMMIT:
+    return "Operation issued while a commit was outstanding";
+  case ERROR_NO_COMMIT_VERSION:
+    return "Transaction is read-only and therefore does not have a commit "
+           "version";
+  case ERROR_TRANSACTION_TOO_LARGE:
+    return "Transaction exceeds byte limit";
+  case ERROR_UNSUPPORTED_OPERATION:
+    return "Operation not supported";
+  case ERROR_API_VERSION_ALREADY_SET:
+    return "API version may be set only once";
+  case ERROR_API_VERSION_INVALID:
+    return "API version not valid";
+  default:
+    return "UNKNOWN_ERROR";
+  }
+}
+
+static int
+is_retryable(fdb_error_t code) {
+  switch (code) {
+  case 1007:
+  case 1009:
+  case ERROR_NOT_COMMITTED:
+  case 1021:
+  case 1037:
+  case 1042:
+  case 1051:
+  case 1213:
+    return 1;
+  default:
+    return 0;
+  }
+}
+
+fdb_bool_t
+fdb_error_predicate(int predicate_test, fdb_error_t code) {
+  switch (predicate_test) {
+  case PREDICATE_RETRYABLE:
+    return is_retryable(code);
+  case PREDICATE_MAYBE_COMMITTED:
+    return code == 1021;
+  case PREDICATE_RETRYABLE_NOT_COMMITTED:
+    return is_retryable(code) && code != 1021;
+  default:
+    return 0;
+  }
+}
+
+/* Network */
+
+fdb_error_t
+fdb_select_api_version_impl(int runtime_version, int header_version) {
+  if (selected_api_version) {
+    return ERROR_API_VERSION_ALREADY_SET;
+  }
+  if (runtime_version > header_version || runtime_version > API_VERSION) {
+    return ERROR_API_VERSION_INVALID;
+  }
+  selected_api_version = runtime_version;
+  return 0;
+}
+
+int
+fdb_get_max_api_version(void) {
+  return API_VERSION;
+}
+
+fdb_error_t
+fdb_network_set_option(int option, uint8_t const *value, int value_length) {
+  return 0;
+}
+
+fdb_error_t
+fdb_setup_network(void) {
+  if (network_setup) {
+    return ERROR_NETWORK_ALREADY_SETUP;
+  }
+  network_setup = 1;
+  return 0;
+}
+
+fdb_error_t
+fdb_run_network(void) {
+  for (;;) {
+    FDBFuture *future;
+
+    pthread_mutex_lock(&network_lock);
+    while (!network_head && !network_stopped) {
+      pthread_cond_wait(&network_signal, &network_lock);
+    }
+    if (!network_head) {
+      pthread_mutex_unlock(&network_lock);
+      return 0;
+    }
+    future = network_head;
+    network_head = NULL;
+    network_tail = NULL;
+    pthread_mutex_unlock(&network_lock);
+
+    while (future) {
+      FDBFuture *next = future->next;
+      future_complete(future);
+      future = next;
+    }
+  }
+}
+
+fdb_error_t
+fdb_stop_network(void) {
+  pthread_mutex_lock(&network_lock);
+  network_stopped = 1;
+  pthread_cond_signal(&network_signal);
+  pthread_mutex_unlock(&network_lock);
+  return 0;
+}
+
+/* Future accessors */
+
+void
+fdb_future_cancel(FDBFuture *f) {}
+
+void
+fdb_future_release_memory(FDBFuture *f) {}
+
+void
+fdb_future_destroy(FDBFuture *f) {
+  future_release(f);
+}
+
+fdb_error_t
+fdb_future_block_until_ready(FDBFuture *f) {
+  pthread_mutex_lock(&future_lock);
+  while (!f->ready) {
+    pthread_cond_wait(&future_ready, &future_lock);
+  }
+  pthread_mutex_unlock(&future_lock);
+  return 0;
+}
+
+fdb_bool_t
+fdb_future_is_ready(FDBFuture *f) {
+  fdb_bool_t ready;
+  pthread_mutex_lock(&future_lock);
+  ready = f->ready;
+  pthread_mutex_unlock(&future_lock);
+  return ready;
+}
+
+fdb_error_t
+fdb_future_set_callback(FDBFuture *f, FDBCallback callback,
+                        void *callback_parameter) {
+  int ready;
+  pthread_mutex_lock(&future_lock);
+  f->callback = callback;
+  f->callback_parameter = callback_parameter;
+  ready = f->ready;
+  pthread_mutex_unlock(&future_lock);
+
+  /* like libfdb_c the callback could be invoked right away, but going
+   * through the network thread keeps the thread handoff in every
+   * measurement */
+  if (ready) {
+    future_schedule(f);
+  }
+  return 0;
+}
+
+fdb_error_t
+fdb_future_get_error(FDBFuture *f) {
+  return f->error;
+}
+
+fdb_error_t
+fdb_future_get_int64(FDBFuture *f, int64_t *out) {
+  if (f->error) {
+    return f->error;
+  }
+  *out = f->int64;
+  return 0;
+}
+
+fdb_error_t
+fdb_future_get_key(FDBFuture *f, uint8_t const **out_key, int *out_key_length) {
+  if (f->error) {
+    return f->error;
+  }
+  *out_key = f->bytes;
+  *out_key_length = f->bytes_length;
+  return 0;
+}
+
+fdb_error_t
+fdb_future_get_value(FDBFuture *f, fdb_bool_t *out_present,
+                     uint8_t const **out_value, int *out_value_length) {
+  if (f->error) {
+    return f->error;
+  }
+  *out_present = f->present;
+  *out_value = f->bytes;
+  *out_value_length = f->bytes_length;
+  return 0;
+}
+
+fdb_error_t
+fdb_future_get_keyvalue_array(FDBFuture *f, FDBKeyValue const **out_kv,
+                              int *out_count, fdb_bool_t *out_more) {
+  if (f->error) {
+    return f->error;
+  }
+  *out_kv = f->key_values;
+  *out_count = f->count;
+  *out_more = f->more;
+  return 0;
+}
+
+/* Mapped range reads are not implemented, the future always fails
+ * with unsupported_operation. */
+fdb_error_t
+fdb_future_get_mappedkeyvalue_array(FDBFuture *f,
+                                    FDBMappedKeyValue const **out_kv,
+                                    int *out_count, fdb_bool_t *out_more) {
+  return f->error ? f->error : ERROR_UNSUPPORTED_OPERATION;
+}
+
+fdb_error_t
+fdb_future_get_key_array(FDBFuture *f, FDBKey const **out_key_array,
+                         int *out_count) {
+  if (f->error) {
+    return f->error;
+  }
+  *out_key_array = f->keys;
+  *out_count = f->count;
+  return 0;
+}
+
+fdb_error_t
+fdb_future_get_string_array(FDBFuture *f, const char ***out_strings,
+                            int *out_count) {
+  if (f->error) {
+    return f->error;
+  }
+  *out_strings = addresses;
+  *out_count = 1;
+  return 0;
+}
+
+/* Database */
+
+fdb_error_t
+fdb_create_database(const char *cluster_file_path, FDBDatabase **out_database) {
+  FDBDatabase *database;
+
+  if (cluster_file_path) {
+    FILE *file = fopen(cluster_file_path, "r");
+    if (!file) {
+      return ERROR_NO_CLUSTER_FILE_FOUND;
+    }
+    fclose(file);
+  }
+
+  database = malloc(sizeof(FDBDatabase));
+  database->store = &global_store;
+  *out_database = database;
+  return 0;
+}
+
+void
+fdb_database_destroy(FDBDatabase *d) {
+  free(d);
+}
+
+fdb_error_t
+fdb_database_set_option(FDBDatabase *d, int option, uint8_t const *value,
+                        int value_length) {
+  return 0;
+}
+
+/* Completes the pending versionstamp futures with the stamp, or with
+ * the error if it's not zero. */
+static void
+transaction_complete_versionstamps(FDBTransaction *tr, uint8_t const *stamp,
+                                   fdb_error_t error) {
+  int i;
+  for (i = 0; i < tr->versionstamp_count; i++) {
+    FDBFuture *future = tr->versionstamps[i];
+    if (error) {
+      future->error = error;
+    } else {
+      future->bytes = copy_bytes(stamp, 10);
+      future->bytes_length = 10;
+    }
+    future_schedule(future);
+    future_release(future);
+  }
+  tr->versionstamp_count = 0;
+}
+
+static void
+transaction_reset(FDBTransaction *tr) {
+  Mutation *mutation = tr->mutations;
+  int i;
+
+  table_destroy(&tr->writes);
+  for (i = 0; i < tr->clear_count; i++) {
+    free(tr->clears[i].begin);
+    free(tr->clears[i].end);
+  }
+  tr->clear_count = 0;
+  while (mutation) {
+    Mutation *next = mutation->next;
+    free(mutation->key);
+    free(mutation->param);
+    free(mutation);
+    mutation = next;
+  }
+  tr->mutations = NULL;
+  tr->last_mutation = NULL;
+  transaction_complete_versionstamps(tr, NULL, ERROR_TRANSACTION_CANCELLED);
+
+  tr->read_version = -1;
+  tr->committed_version = -1;
+  tr->size = 0;
+  tr->size_limit = DEFAULT_SIZE_LIMIT;
+  tr->started_at = now_ms();
+  tr->system_keys = 0;
+  tr->committing = 0;
+  tr->cancelled = 0;
+  tr->deferred_error = 0;
+}
+
+fdb_error_t
+fdb_database_create_transaction(FDBDatabase *d,
+                                FDBTransaction **out_transaction) {
+  FDBTransaction *tr = calloc(1, sizeof(FDBTransaction));
+  tr->store = d->store;
+  tr->retry_limit = -1;
+  pthread_mutex_init(&tr->lock, NULL);
+  transaction_reset(tr);
+  *out_transaction = tr;
+  return 0;
+}
+
+/* Tenant */
+
+fdb_error_t
+fdb_database_open_tenant(FDBDatabase *d, uint8_t const *tenant_name,
+                         int tenant_name_length, FDBTenant **out_tenant) {
+  TenantStore *tenant_store;
+  FDBTenant *tenant;
+
+  pthread_mutex_lock(&tenant_lock);
+  for (tenant_store = tenant_stores; tenant_store;
+       tenant_store = tenant_store->next) {
+    if (tenant_store->name_length == tenant_name_length &&
+        memcmp(tenant_store->name, tenant_name, tenant_name_length) == 0) {
+      break;
+    }
+  }
+  if (!tenant_store) {
+    tenant_store = calloc(1, sizeof(TenantStore));
+    tenant_store->name = malloc(tenant_name_length + 1);
+    memcpy(tenant_store->name, tenant_name, tenant_name_length);
+    tenant_store->name_length = tenant_name_length;
+    tenant_store->store.version = 1;
+    pthread_rwlock_init(&tenant_store->store.lock, NULL);
+    tenant_store->next = tenant_stores;
+    tenant_stores = tenant_store;
+  }
+  pthread_mutex_unlock(&tenant_lock);
+
+  tenant = malloc(sizeof(FDBTenant));
+  tenant->store = &tenant_store->store;
+  *out_tenant = tenant;
+  return 0;
+}
+
+void
+fdb_tenant_destroy(FDBTenant *t) {
+  free(t);
+}
+
+fdb_error_t
+fdb_tenant_create_transaction(FDBTenant *t, FDBTransaction **out_transaction) {
+  FDBDatabase database;
+  database.store = t->store;
+  return fdb_database_create_transaction(&database, out_transaction);
+}
+
+/* Transaction */
+
+void
+fdb_transaction_destroy(FDBTransaction *tr) {
+  transaction_reset(tr);
+  free(tr->clears);
+  free(tr->versionstamps);
+  pthread_mutex_destroy(&tr->lock);
+  free(tr);
+}
+
+void
+fdb_transaction_cancel(FDBTransaction *tr) {
+  pthread_mutex_lock(&tr->lock);
+  tr->cancelled = 1;
+  transaction_complete_versionstamps(tr, NULL, ERROR_TRANSACTION_CANCELLED);
+  pthread_mutex_unlock(&tr->lock);
+}
+
+static int64_t
+option_int(uint8_t const *value, int value_length) {
+  int64_t result = 0;
+  int i;
+  for (i = value_length - 1; i >= 0; i--) {
+    result = (result << 8) | value[i];
+  }
+  return result;
+}
+
+fdb_error_t
+fdb_transaction_set_option(FDBTransaction *tr, int option, uint8_t const *value,
+                           int value_length) {
+  pthread_mutex_lock(&tr->lock);
+  switch (option) {
+  case OPTION_TIMEOUT:
+    tr->timeout = option_int(value, value_length);
+    break;
+  case OPTION_RETRY_LIMIT:
+    tr->retry_limit = (int)option_int(value, value_length);
+    break;
+  case OPTION_SIZE_LIMIT:
+    tr->size_limit = option_int(value, value_length);
+    break;
+  case OPTION_ACCESS_SYSTEM_KEYS:
+  case OPTION_READ_SYSTEM_KEYS:
+    tr->system_keys = 1;
+    break;
+  default:
+    break;
+  }
+  pthread_mutex_unlock(&tr->lock);
+  return 0;
+}
+
+/* Returns the error that should fail any operation on the transaction */
+static fdb_error_t
+transaction_check(FDBTransaction *tr) {
+  if (tr->cancelled) {
+    return ERROR_TRANSACTION_CANCELLED;
+  }
+  if (tr->committing) {
+    return ERROR_USED_DURING_COMMIT;
+  }
+  if (tr->timeout > 0 && now_ms() - tr->started_at >= tr->timeout) {
+    return ERROR_TIMED_OUT;
+  }
+  return 0;
+}
+
+static fdb_error_t
+transaction_check_key(FDBTransaction *tr, uint8_t const *key, int key_length) {
+  if (key_length > 0 && key[0] == 0xFF && !tr->system_keys) {
+    return ERROR_KEY_OUTSIDE_LEGAL_RANGE;
+  }
+  return 0;
+}
+
+static void
+transaction_read_version(FDBTransaction *tr) {
+  if (tr->read_version < 0) {
+    tr->read_version = tr->store->version;
+  }
+}
+
+static int
+transaction_cleared(FDBTransaction *tr, uint8_t const *key, int key_length) {
+  int i;
+  for (i = 0; i < tr->clear_count; i++) {
+    Range *range = &tr->clears[i];
+    if (compare_bytes(range->begin, range->begin_length, key, key_length) <= 0 &&
+        compare_bytes(key, key_length, range->end, range->end_length) < 0) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+/* The view of a transaction is the store overlaid with the writes and
+ * clears buffered in the transaction. The caller must hold the
+ * transaction lock and the store read lock. */
+
+typedef struct {
+  uint8_t const *key;
+  int key_length;
+  uint8_t const *value;
+  int value_length;
+  int valid;
+} View;
+
+static View
+view_entry(Entry *entry) {
+  View view;
+  view.key = entry->key;
+  view.key_length = entry->key_length;
+  view.value = entry->value;
+  view.value_length = entry->value_length;
+  view.valid = 1;
+  return view;
+}
+
+static View
+view_none(void) {
+  View view;
+  memset(&view, 0, sizeof(View));
+  return view;
+}
+
+static View
+view_get(FDBTransaction *tr, uint8_t const *key, int key_length) {
+  Entry *entry = table_find(&tr->writes, key, key_length);
+  if (entry) {
+    return entry->present ? view_entry(entry) : view_none();
+  }
+  if (transaction_cleared(tr, key, key_length) >= 0) {
+    return view_none();
+  }
+  entry = table_find(&tr->store->table, key, key_length);
+  return entry ? view_entry(entry) : view_none();
+}
+
+static int
+view_key_equal(Table *table, int i, uint8_t const *key, int key_length) {
+  return i >= 0 && i < table->count &&
+         compare_bytes(table->entries[i].key, table->entries[i].key_length, key,
+                       key_length) == 0;
+}
+
+static View
+view_pick(View a, View b, int smaller) {
+  int cmp;
+  if (!a.valid) {
+    return b;
+  }
+  if (!b.valid) {
+    return a;
+  }
+  cmp = compare_bytes(a.key, a.key_length, b.key, b.key_length);
+  if (smaller) {
+    return cmp <= 0 ? a : b;
+  }
+  return cmp >= 0 ? a : b;
+}
+
+/* first key greater than (or equal to, if inclusive) the given key */
+static View
+view_next(FDBTransaction *tr, uint8_t const *key, int key_length,
+          int inclusive) {
+  Table *store = &tr->store->table;
+  Table *writes = &tr->writes;
+  View from_store = view_none();
+  View from_writes = view_none();
+  int i = table_lower_bound(store, key, key_length);
+  int j = table_lower_bound(writes, key, key_length);
+
+  if (!inclusive && view_key_equal(store, i, key, key_length)) {
+    i++;
+  }
+  while (i < store->count) {
+    Entry *entry = &store->entries[i];
+    int cleared = transaction_cleared(tr, entry->key, entry->key_length);
+    if (cleared >= 0) {
+      Range *range = &tr->clears[cleared];
+      i = table_lower_bound(store, range->end, range->end_length);
+      continue;
+    }
+    if (table_find(writes, entry->key, entry->key_length)) {
+      i++;
+      continue;
+    }
+    from_store = view_entry(entry);
+    break;
+  }
+
+  if (!inclusive && view_key_equal(writes, j, key, key_length)) {
+    j++;
+  }
+  while (j < writes->count && !writes->entries[j].present) {
+    j++;
+  }
+  if (j < writes->count) {
+    from_writes = view_entry(&writes->entries[j]);
+  }
+
+  return view_pick(from_store, from_writes, 1);
+}
+
+/* last key less than (or equal to, if inclusive) the given key */
+static View
+view_previous(FDBTransaction *tr, uint8_t const *key, int key_length,
+              int inclusive) {
+  Table *store = &tr->store->table;
+  Table *writes = &tr->writes;
+  View from_store = view_none();
+  View from_writes = view_none();
+  int i = table_lower_bound(store, key, key_length);
+  int j = table_lower_bound(writes, key, key_length);
+
+  if (!(inclusive && view_key_equal(store, i, key, key_length))) {
+    i--;
+  }
+  while (i >= 0) {
+    Entry *entry = &store->entries[i];
+    int cleared = transaction_cleared(tr, entry->key, entry->key_length);
+    if (cleared >= 0) {
+      Range *range = &tr->clears[cleared];
+      i = table_lower_bound(store, range->begin, range->begin_length) - 1;
+      continue;
+    }
+    if (table_find(writes, entry->key, entry->key_length)) {
+      i--;
+      continue;
+    }
+    from_store = view_entry(entry);
+    break;
+  }
+
+  if (!(inclusive && view_key_equal(writes, j, key, key_length))) {
+    j--;
+  }
+  while (j >= 0 && !writes->entries[j].present) {
+    j--;
+  }
+  if (j >= 0) {
+    from_writes = view_entry(&writes->entries[j]);
+  }
+
+  return view_pick(from_store, from_writes, 0);
+}
+
+/* Resolves a key selector to a key. Selectors which run past the end
+ * of the database resolve to \xff (\xff\xff with system keys access)
+ * and the ones which run past the beginning resolve to the empty
+ * key. */
+static View
+view_resolve(FDBTransaction *tr, uint8_t const *key, int key_length,
+             fdb_bool_t or_equal, int offset) {
+  View view;
+  View end = view_none();
+
+  end.key = tr->system_keys ? SYSTEM_END_KEY : END_KEY;
+  end.key_length = tr->system_keys ? 2 : 1;
+  end.valid = 1;
+
+  if (offset > 0) {
+    view = view_next(tr, key, key_length, !or_equal);
+    while (view.valid && --offset > 0) {
+      view = view_next(tr, view.key, view.key_length, 0);
+    }
+    if (!view.valid || compare_bytes(view.key, view.key_length, end.key,
+                                     end.key_length) > 0) {
+      return end;
+    }
+    return view;
+  }
+
+  view = view_previous(tr, key, key_length, or_equal);
+  while (view.valid && offset++ < 0) {
+    view = view_previous(tr, view.key, view.key_length, 0);
+  }
+  if (!view.valid) {
+    view = view_none();
+    view.key = END_KEY;
+    view.key_length = 0;
+    view.valid = 1;
+  }
+  return view;
+}
+
+fdb_error_t
+fdb_transaction_get_committed_version(FDBTransaction *tr,
+                                      int64_t *out_version) {
+  *out_version = tr->committed_version;
+  return 0;
+}
+
+void
+fdb_transaction_set_read_version(FDBTransaction *tr, int64_t version) {
+  pthread_mutex_lock(&tr->lock);
+  tr->read_version = version;
+  pthread_mutex_unlock(&tr->lock);
+}
+
+FDBFuture *
+fdb_transaction_get_read_version(FDBTransaction *tr) {
+  FDBFuture *future;
+  fdb_error_t error;
+
+  pthread_mutex_lock(&tr->lock);
+  error = transaction_check(tr);
+  if (error) {
+    pthread_mutex_unlock(&tr->lock);
+    return future_error(FUTURE_INT64, error);
+  }
+  pthread_rwlock_rdlock(&tr->store->lock);
+  transaction_read_version(tr);
+  pthread_rwlock_unlock(&tr->store->lock);
+
+  future = future_create(FUTURE_INT64);
+  future->int64 = tr->read_version;
+  pthread_mutex_unlock(&tr->lock);
+  return future_schedule(future);
+}
+
+FDBFuture *
+fdb_transaction_get(FDBTransaction *tr, uint8_t const *key_name,
+                    int key_name_length, fdb_bool_t snapshot) {
+  FDBFuture *future;
+  View view;
+  fdb_error_t error;
+
+  pthread_mutex_lock(&tr->lock);
+  error = transaction_check(tr);
+  if (!error) {
+    error = transaction_check_key(tr, key_name, key_name_length);
+  }
+  if (error) {
+    pthread_mutex_unlock(&tr->lock);
+    return future_error(FUTURE_VALUE, error);
+  }
+
+  future = future_create(FUTURE_VALUE);
+  pthread_rwlock_rdlock(&tr->store->lock);
+  transaction_read_version(tr);
+  view = view_get(tr, key_name, key_name_length);
+  if (view.valid) {
+    future->present = 1;
+    future->bytes = copy_bytes(view.value, view.value_length);
+    future->bytes_length = view.value_length;
+  }
+  pthread_rwlock_unlock(&tr->store->lock);
+  pthread_mutex_unlock(&tr->lock);
+  return future_schedule(future);
+}
+
+FDBFuture *
+fdb_transaction_get_key(FDBTransaction *tr, uint8_t const *key_name,
+                        int key_name_length, fdb_bool_t or_equal, int offset,
+                        fdb_bool_t snapshot) {
+  FDBFuture *future;
+  View view;
+  fdb_error_t error;
+
+  pthread_mutex_lock(&tr->lock);
+  error = transaction_check(tr);
+  if (error) {
+    pthread_mutex_unlock(&tr->lock);
+    return future_error(FUTURE_KEY, error);
+  }
+
+  future = future_create(FUTURE_KEY);
+  pthread_rwlock_rdlock(&tr->store->lock);
+  transaction_read_version(tr);
+  view = view_resolve(tr, key_name, key_name_length, or_equal, offset);
+  future->bytes = copy_bytes(view.key, view.key_length);
+  future->bytes_length = view.key_length;
+  pthread_rwlock_unlock(&tr->store->lock);
+  pthread_mutex_unlock(&tr->lock);
+  return future_schedule(future);
+}
+
+FDBFuture *
+fdb_transaction_get_addresses_for_key(FDBTransaction *tr,
+                                      uint8_t const *key_name,
+                                      int key_name_length) {
+  return future_schedule(future_create(FUTURE_STRING_ARRAY));
+}
+
+static int
+range_byte_limit(int target_bytes, FDBStreamingMode mode, int iteration) {
+  int limit;
+  switch (mode) {
+  case FDB_STREAMING_MODE_ITERATOR:
+    limit = 4096;
+    while (--iteration > 0 && limit < 81920) {
+      limit *= 2;
+    }
+    break;
+  case FDB_STREAMING_MODE_SMALL:
+    limit = 4096;
+    break;
+  case FDB_STREAMING_MODE_MEDIUM:
+    limit = 16384;
+    break;
+  case FDB_STREAMING_MODE_LARGE:
+    limit = 81920;
+    break;
+  case FDB_STREAMING_MODE_SERIAL:
+    limit = 1000000;
+    break;
+  default:
+    limit = 0;
+  }
+  if (target_bytes > 0 && (limit == 0 || target_bytes < limit)) {
+    limit = target_bytes;
+  }
+  return limit;
+}
+
+static void
+future_push_key_value(FDBFuture *future, int *capacity, View *view) {
+  FDBKeyValue *kv;
+  if (future->count == *capacity) {
+    *capacity = *capacity ? *capacity * 2 : 16;
+    future->key_values =
+        realloc(future->key_values, sizeof(FDBKeyValue) * *capacity);
+  }
+  kv = &future->key_values[future->count++];
+  kv->key = copy_bytes(view->key, view->key_length);
+  kv->key_length = view->key_length;
+  kv->value = copy_bytes(view->value, view->value_length);
+  kv->value_length = view->value_length;
+}
+
+FDBFuture *
+fdb_transaction_get_range(FDBTransaction *tr, uint8_t const *begin_key_name,
+                          int begin_key_name_length, fdb_bool_t begin_or_equal,
+                          int begin_offset, uint8_t const *end_key_name,
+                          int end_key_name_length, fdb_bool_t end_or_equal,
+                          int end_offset, int limit, int target_bytes,
+                          FDBStreamingMode mode, int iteration,
+                          fdb_bool_t snapshot, fdb_bool_t reverse) {
+  FDBFuture *future;
+  View begin;
+  View end;
+  View view;
+  fdb_error_t error;
+  int byte_limit = range_byte_limit(target_bytes, mode, iteration);
+  int bytes = 0;
+  int capacity = 0;
+
+  pthread_mutex_lock(&tr->lock);
+  error = transaction_check(tr);
+  if (error) {
+    pthread_mutex_unlock(&tr->lock);
+    return future_error(FUTURE_KEYVALUE_ARRAY, error);
+  }
+
+  future = future_create(FUTURE_KEYVALUE_ARRAY);
+  pthread_rwlock_rdlock(&tr->store->lock);
+  transaction_read_version(tr);
+  begin = view_resolve(tr, begin_key_name, begin_key_name_length,
+                       begin_or_equal, begin_offset);
+  end = view_resolve(tr, end_key_name, end_key_name_length, end_or_equal,
+                     end_offset);
+
+  if (compare_bytes(begin.key, begin.key_length, end.key, end.key_length) <
+      0) {
+    view = reverse ? view_previous(tr, end.key, end.key_length, 0)
+                   : view_next(tr, begin.key, begin.key_length, 1);
+
+    while (view.valid &&
+           compare_bytes(view.key, view.key_length, begin.key,
+                         begin.key_length) >= 0 &&
+           compare_bytes(view.key, view.key_length, end.key, end.key_length) <
+               0) {
+      if ((limit > 0 && future->count >= limit) ||
+          (byte_limit > 0 && bytes >= byte_limit)) {
+        future->more = 1;
+        break;
+      }
+      future_push_key_value(future, &capacity, &view);
+      bytes += view.key_length + view.value_length;
+      view = reverse ? view_previous(tr, view.key, view.key_length, 0)
+                     : view_next(tr, view.key, view.key_length, 0);
+    }
+  }
+
+  pthread_rwlock_unlock(&tr->store->lock);
+  pthread_mutex_unlock(&tr->lock);
+  return future_schedule(future);
+}
+
+static void
+transaction_add_mutation(FDBTransaction *tr, int type, uint8_t const *key,
+                         int key_length, uint8_t const *param,
+                         int param_length) {
+  Mutation *mutation = malloc(sizeof(Mutation));
+  mutation->type = type;
+  mutation->key = copy_bytes(key, key_length);
+  mutation->key_length = key_length;
+  mutation->param = copy_bytes(param, param_length);
+  mutation->param_length = param_length;
+  mutation->next = NULL;
+  if (tr->last_mutation) {
+    tr->last_mutation->next = mutation;
+  } else {
+    tr->mutations = mutation;
+  }
+  tr->last_mutation = mutation;
+  tr->size += key_length + param_length;
+}
+
+static void
+transaction_add_clear(FDBTransaction *tr, uint8_t const *begin,
+                      int begin_length, uint8_t const *end, int end_length) {
+  Range *range;
+  if (tr->clear_count == tr->clear_capacity) {
+    tr->clear_capacity = tr->clear_capacity ? tr->clear_capacity * 2 : 4;
+    tr->clears = realloc(tr->clears, sizeof(Range) * tr->clear_capacity);
+  }
+  range = &tr->clears[tr->clear_count++];
+  range->begin = copy_bytes(begin, begin_length);
+  range->begin_length = begin_length;
+  range->end = copy_bytes(end, end_length);
+  range->end_length = end_length;
+}
+
+static int
+transaction_can_write(FDBTransaction *tr, uint8_t const *key, int key_length) {
+  fdb_error_t error = transaction_check(tr);
+  if (!error) {
+    error = transaction_check_key(tr, key, key_length);
+  }
+  if (error && !tr->deferred_error) {
+    tr->deferred_error = error;
+  }
+  return !error;
+}
+
+FDBFuture *
+fdb_transaction_get_mapped_range(
+    FDBTransaction *tr, uint8_t const *begin_key_name,
+    int begin_key_name_length, fdb_bool_t begin_or_equal, int begin_offset,
+    uint8_t const *end_key_name, int end_key_name_length,
+    fdb_bool_t end_or_equal, int end_offset, uint8_t const *mapper_name,
+    int mapper_name_length, int limit, int target_bytes, FDBStreamingMode mode,
+    int iteration, fdb_bool_t snapshot, fdb_bool_t reverse) {
+  return future_error(FUTURE_KEYVALUE_ARRAY, ERROR_UNSUPPORTED_OPERATION);
+}
+
+void
+fdb_transaction_set(FDBTransaction *tr, uint8_t const *key_name,
+                    int key_name_length, uint8_t const *value,
+                    int value_length) {
+  pthread_mutex_lock(&tr->lock);
+  if (transaction_can_write(tr, key_name, key_name_length)) {
+    table_put(&tr->writes, key_name, key_name_length, value, value_length, 1);
+    transaction_add_mutation(tr, MUTATION_SET, key_name, key_name_length, value,
+                             value_length);
+  }
+  pthread_mutex_unlock(&tr->lock);
+}
+
+/* Computes the result of an atomic operation, returns 0 if the key
+ * should be cleared. result must be able to hold
+ * max(param_length, existing_length + param_length) bytes. */
+static int
+atomic_apply(int type, View *existing, uint8_t const *param, int param_length,
+             uint8_t *result, int *result_length) {
+  int i;
+  int carry = 0;
+  uint8_t const *old = existing->valid ? existing->value : NULL;
+  int old_length = existing->valid ? existing->value_length : 0;
+
+#define OLD_BYTE(i) ((old && (i) < old_length) ? old[(i)] : 0)
+
+  *result_length = param_length;
+  switch (type) {
+  case MUTATION_ADD:
+    for (i = 0; i < param_length; i++) {
+      int sum = OLD_BYTE(i) + param[i] + carry;
+      result[i] = sum & 0xFF;
+      carry = sum >> 8;
+    }
+    return 1;
+  case MUTATION_AND:
+    for (i = 0; i < param_length; i++) {
+      result[i] = old ? (OLD_BYTE(i) & param[i]) : param[i];
+    }
+    return 1;
+  case MUTATION_OR:
+    for (i = 0; i < param_length; i++) {
+      result[i] = OLD_BYTE(i) | param[i];
+    }
+    return 1;
+  case MUTATION_XOR:
+    for (i = 0; i < param_length; i++) {
+      result[i] = OLD_BYTE(i) ^ param[i];
+    }
+    return 1;
+  case MUTATION_APPEND_IF_FITS:
+    if (old_length + param_length > VALUE_SIZE_LIMIT) {
+      memcpy(result, old, old_length);
+      *result_length = old_length;
+      return old != NULL;
+    }
+    if (old_length > 0) {
+      memcpy(result, old, old_length);
+    }
+    memcpy(result + old_length, param, param_length);
+    *result_length = old_length + param_length;
+    return 1;
+  case MUTATION_MAX:
+  case MUTATION_MIN: {
+    int cmp = 0;
+    if (!old) {
+      memcpy(result, param, param_length);
+      return 1;
+    }
+    for (i = param_length - 1; i >= 0 && cmp == 0; i--) {
+      cmp = (int)OLD_BYTE(i) - (int)param[i];
+    }
+    if ((type == MUTATION_MAX && cmp > 0) ||
+        (type == MUTATION_MIN && cmp < 0)) {
+      for (i = 0; i < param_length; i++) {
+        result[i] = OLD_BYTE(i);
+      }
+    } else {
+      memcpy(result, param, param_length);
+    }
+    return 1;
+  }
+  case MUTATION_BYTE_MIN:
+  case MUTATION_BYTE_MAX: {
+    int cmp = old ? compare_bytes(old, old_length, param, param_length) : 0;
+    if (old && ((type == MUTATION_BYTE_MAX && cmp > 0) ||
+                (type == MUTATION_BYTE_MIN && cmp < 0))) {
+      memcpy(result, old, old_length);
+      *result_length = old_length;
+    } else {
+      memcpy(result, param, param_length);
+    }
+    return 1;
+  }
+  case MUTATION_COMPARE_AND_CLEAR:
+    if (old && compare_bytes(old, old_length, param, param_length) == 0) {
+      return 0;
+    }
+    if (!old) {
+      return 0;
+    }
+    memcpy(result, old, old_length);
+    *result_length = old_length;
+    return 1;
+  default:
+    memcpy(result, param, param_length);
+    return 1;
+  }
+#undef OLD_BYTE
+}
+
+void
+fdb_transaction_atomic_op(FDBTransaction *tr, uint8_t const *key_name,
+                          int key_name_length, uint8_t const *param,
+                          int param_length, int operation_type) {
+  pthread_mutex_lock(&tr->lock);
+  if (operation_type == MUTATION_SET_VERSIONSTAMPED_KEY ||
+      operation_type == MUTATION_SET_VERSIONSTAMPED_VALUE) {
+    /* the transformed key or value is not readable in the transaction */
+    if (transaction_can_write(tr, NULL, 0)) {
+      transaction_add_mutation(tr, operation_type, key_name, key_name_length,
+                               param, param_length);
+    }
+  } else if (transaction_can_write(tr, key_name, key_name_length)) {
+    View existing;
+    uint8_t *result;
+    int result_length;
+
+    pthread_rwlock_rdlock(&tr->store->lock);
+    existing = view_get(tr, key_name, key_name_length);
+    result = malloc(param_length + (existing.valid ? existing.value_length : 0) +
+                    1);
+    if (atomic_apply(operation_type, &existing, param, param_length, result,
+                     &result_length)) {
+      table_put(&tr->writes, key_name, key_name_length, result, result_length,
+                1);
+    } else {
+      table_put(&tr->writes, key_name, key_name_length, NULL, 0, 0);
+    }
+    pthread_rwlock_unlock(&tr->store->lock);
+    free(result);
+
+    transaction_add_mutation(tr, operation_type, key_name, key_name_length,
+                             param, param_length);
+  }
+  pthread_mutex_unlock(&tr->lock);
+}
+
+void
+fdb_transaction_clear(FDBTransaction *tr, uint8_t const *key_name,
+                      int key_name_length) {
+  pthread_mutex_lock(&tr->lock);
+  if (transaction_can_write(tr, key_name, key_name_length)) {
+    table_put(&tr->writes, key_name, key_name_length, NULL, 0, 0);
+    transaction_add_mutation(tr, MUTATION_CLEAR, key_name, key_name_length,
+                             NULL, 0);
+  }
+  pthread_mutex_unlock(&tr->lock);
+}
+
+void
+fdb_transaction_clear_range(FDBTransaction *tr, uint8_t const *begin_key_name,
+                            int begin_key_name_length,
+                            uint8_t const *end_key_name,
+                            int end_key_name_length) {
+  pthread_mutex_lock(&tr->lock);
+  if (transaction_can_write(tr, begin_key_name, begin_key_name_length)) {
+    if (compare_bytes(begin_key_name, begin_key_name_length, end_key_name,
+                      end_key_name_length) > 0) {
+      tr->deferred_error = ERROR_INVERTED_RANGE;
+    } else {
+      table_clear_range(&tr->writes, begin_key_name, begin_key_name_length,
+                        end_key_name, end_key_name_length);
+      transaction_add_clear(tr, begin_key_name, begin_key_name_length,
+                            end_key_name, end_key_name_length);
+      transaction_add_mutation(tr, MUTATION_CLEAR_RANGE, begin_key_name,
+                               begin_key_name_length, end_key_name,
+                               end_key_name_length);
+    }
+  }
+  pthread_mutex_unlock(&tr->lock);
+}
+
+FDBFuture *
+fdb_transaction_watch(FDBTransaction *tr, uint8_t const *key_name,
+                      int key_name_length) {
+  FDBFuture *future;
+  View view;
+  fdb_error_t error;
+
+  pthread_mutex_lock(&tr->lock);
+  error = transaction_check(tr);
+  if (error) {
+    pthread_mutex_unlock(&tr->lock);
+    return future_error(FUTURE_EMPTY, error);
+  }
+
+  future = future_create(FUTURE_EMPTY);
+  future->watch_key = copy_bytes(key_name, key_name_length);
+  future->watch_key_length = key_name_length;
+  /* a watch holds a reference till it fires */
+  future->references++;
+
+  pthread_rwlock_wrlock(&tr->store->lock);
+  view = view_get(tr, key_name, key_name_length);
+  if (view.valid) {
+    future->present = 1;
+    future->bytes = copy_bytes(view.value, view.value_length);
+    future->bytes_length = view.value_length;
+  }
+  future->next_watch = tr->store->watches;
+  tr->store->watches = future;
+  pthread_rwlock_unlock(&tr->store->lock);
+  pthread_mutex_unlock(&tr->lock);
+  return future;
+}
+
+/* Must be called with the store write lock held */
+static void
+store_fire_watches(Store *store) {
+  FDBFuture **link = &store->watches;
+  while (*link) {
+    FDBFuture *watch = *link;
+    Entry *entry =
+        table_find(&store->table, watch->watch_key, watch->watch_key_length);
+    int changed =
+        entry ? (!watch->present ||
+                 compare_bytes(entry->value, entry->value_length, watch->bytes,
+                               watch->bytes_length) != 0)
+              : watch->present;
+    if (changed) {
+      *link = watch->next_watch;
+      future_schedule(watch);
+      future_release(watch);
+    } else {
+      link = &watch->next_watch;
+    }
+  }
+}
+
+static void
+versionstamp_fill(uint8_t *stamp, int64_t version) {
+  int i;
+  for (i = 0; i < 8; i++) {
+    stamp[i] = (version >> (8 * (7 - i))) & 0xFF;
+  }
+  stamp[8] = 0;
+  stamp[9] = 0;
+}
+
+/* Splits the trailing 4 byte little endian offset from a versionstamp
+ * operand and substitutes the versionstamp at that offset. */
+static int
+versionstamp_substitute(uint8_t const *data, int length, uint8_t const *stamp,
+                        uint8_t **out, int *out_length) {
+  int offset;
+  if (length < 4) {
+    return 0;
+  }
+  length -= 4;
+  offset = data[length] | (data[length + 1] << 8) | (data[length + 2] << 16) |
+           (data[length + 3] << 24);
+  if (offset < 0 || offset + 10 > length) {
+    return 0;
+  }
+  *out = copy_bytes(data, length);
+  memcpy(*out + offset, stamp, 10);
+  *out_length = length;
+  return 1;
+}
+
+/* Must be called with the store write lock held */
+static void
+store_apply(Store *store, Mutation *mutation, uint8_t const *stamp) {
+  Table *table = &store->table;
+
+  switch (mutation->type) {
+  case MUTATION_SET:
+    table_put(table, mutation->key, mutation->key_length, mutation->param,
+              mutation->param_length, 1);
+    break;
+  case MUTATION_CLEAR: {
+    int i = table_lower_bound(table, mutation->key, mutation->key_length);
+    if (view_key_equal(table, i, mutation->key, mutation->key_length)) {
+      table_erase(table, i, i + 1);
+    }
+    break;
+  }
+  case MUTATION_CLEAR_RANGE:
+    table_clear_range(table, mutation->key, mutation->key_length,
+                      mutation->param, mutation->param_length);
+    break;
+  case MUTATION_SET_VERSIONSTAMPED_KEY: {
+    uint8_t *key;
+    int key_length;
+    if (versionstamp_substitute(mutation->key, mutation->key_length, stamp,
+                                &key, &key_length)) {
+      table_put(table, key, key_length, mutation->param, mutation->param_length,
+                1);
+      free(key);
+    }
+    break;
+  }
+  case MUTATION_SET_VERSIONSTAMPED_VALUE: {
+    uint8_t *value;
+    int value_length;
+    if (versionstamp_substitute(mutation->param, mutation->param_length, stamp,
+                                &value, &value_length)) {
+      table_put(table, mutation->key, mutation->key_length, value, value_length,
+                1);
+      free(value);
+    }
+    break;
+  }
+  default: {
+    Entry *entry = table_find(table, mutation->key, mutation->key_length);
+    View existing = entry ? view_entry(entry) : view_none();
+    uint8_t *result = malloc(mutation->param_length +
+                             (entry ? entry->value_length : 0) + 1);
+    int result_length;
+    if (atomic_apply(mutation->type, &existing, mutation->param,
+                     mutation->param_length, result, &result_length)) {
+      table_put(table, mutation->key, mutation->key_length, result,
+                result_length, 1);
+    } else if (entry) {
+      int i = table_lower_bound(table, mutation->key, mutation->key_length);
+      table_erase(table, i, i + 1);
+    }
+    free(result);
+  }
+  }
+}
+
+FDBFuture *
+fdb_transaction_commit(FDBTransaction *tr) {
+  Mutation *mutation;
+  uint8_t stamp[10];
+  fdb_error_t error;
+
+  pthread_mutex_lock(&tr->lock);
+  error = transaction_check(tr);
+  if (!error) {
+    error = tr->deferred_error;
+  }
+  if (!error && tr->size > tr->size_limit) {
+    error = ERROR_TRANSACTION_TOO_LARGE;
+  }
+  if (error) {
+    pthread_mutex_unlock(&tr->lock);
+    return future_error(FUTURE_EMPTY, error);
+  }
+
+  tr->committing = 1;
+  if (tr->mutations) {
+    pthread_rwlock_wrlock(&tr->store->lock);
+    tr->committed_version = ++tr->store->version;
+    versionstamp_fill(stamp, tr->committed_version);
+    for (mutation = tr->mutations; mutation; mutation = mutation->next) {
+      store_apply(tr->store, mutation, stamp);
+    }
+    store_fire_watches(tr->store);
+    pthread_rwlock_unlock(&tr->store->lock);
+    transaction_complete_versionstamps(tr, stamp, 0);
+  } else {
+    transaction_complete_versionstamps(tr, NULL, ERROR_NO_COMMIT_VERSION);
+  }
+  pthread_mutex_unlock(&tr->lock);
+  return future_schedule(future_create(FUTURE_EMPTY));
+}
+
+FDBFuture *
+fdb_transaction_get_approximate_size(FDBTransaction *tr) {
+  FDBFuture *future = future_create(FUTURE_INT64);
+  pthread_mutex_lock(&tr->lock);
+  future->int64 = tr->size;
+  pthread_mutex_unlock(&tr->lock);
+  return future_schedule(future);
+}
+
+FDBFuture *
+fdb_transaction_get_versionstamp(FDBTransaction *tr) {
+  FDBFuture *future = future_create(FUTURE_KEY);
+  pthread_mutex_lock(&tr->lock);
+  if (tr->versionstamp_count == tr->versionstamp_capacity) {
+    tr->versionstamp_capacity =
+        tr->versionstamp_capacity ? tr->versionstamp_capacity * 2 : 4;
+    tr->versionstamps = realloc(
+        tr->versionstamps, sizeof(FDBFuture *) * tr->versionstamp_capacity);
+  }
+  /* one reference for the caller and one for the transaction */
+  future->references++;
+  tr->versionstamps[tr->versionstamp_count++] = future;
+  pthread_mutex_unlock(&tr->lock);
+  return future;
+}
+
+FDBFuture *
+fdb_transaction_on_error(FDBTransaction *tr, fdb_error_t error) {
+  pthread_mutex_lock(&tr->lock);
+  if (!is_retryable(error) ||
+      (tr->retry_limit >= 0 && tr->retries >= tr->retry_limit)) {
+    pthread_mutex_unlock(&tr->lock);
+    return future_error(FUTURE_EMPTY, error);
+  }
+  tr->retries++;
+  transaction_reset(tr);
+  pthread_mutex_unlock(&tr->lock);
+  return future_schedule(future_create(FUTURE_EMPTY));
+}
+
+fdb_error_t
+fdb_transaction_add_conflict_range(FDBTransaction *tr,
+                                   uint8_t const *begin_key_name,
+                                   int begin_key_name_length,
+                                   uint8_t const *end_key_name,
+                                   int end_key_name_length, int type) {
+  if (compare_bytes(begin_key_name, begin_key_name_length, end_key_name,
+                    end_key_name_length) > 0) {
+    return ERROR_INVERTED_RANGE;
+  }
+  pthread_mutex_lock(&tr->lock);
+  tr->size += begin_key_name_length + end_key_name_length;
+  pthread_mutex_unlock(&tr->lock);
+  return 0;
+}
+
+FDBFuture *
+fdb_transaction_get_estimated_range_size_bytes(FDBTransaction *tr,
+                                               uint8_t const *begin_key_name,
+                                               int begin_key_name_length,
+                                               uint8_t const *end_key_name,
+                                               int end_key_name_length) {
+  FDBFuture *future = future_create(FUTURE_INT64);
+  Table *table = &tr->store->table;
+  int i;
+  int end;
+
+  pthread_rwlock_rdlock(&tr->store->lock);
+  i = table_lower_bound(table, begin_key_name, begin_key_name_length);
+  end = table_lower_bound(table, end_key_name, end_key_name_length);
+  for (; i < end; i++) {
+    future->int64 += table->entries[i].key_length +
+                     table->entries[i].value_length;
+  }
+  pthread_rwlock_unlock(&tr->store->lock);
+  return future_schedule(future);
+}
+
+static void
+future_push_key(FDBFuture *future, int *capacity, uint8_t const *key,
+                int key_length) {
+  FDBKey *out;
+  if (future->count == *capacity) {
+    *capacity = *capacity ? *capacity * 2 : 16;
+    future->keys = realloc(future->keys, sizeof(FDBKey) * *capacity);
+  }
+  out = &future->keys[future->count++];
+  out->key = copy_bytes(key, key_length);
+  out->key_length = key_length;
+}
+
+FDBFuture *
+fdb_transaction_get_range_split_points(FDBTransaction *tr,
+                                       uint8_t const *begin_key_name,
+                                       int begin_key_name_length,
+                                       uint8_t const *end_key_name,
+                                       int end_key_name_length,
+                                       int64_t chunk_size) {
+  FDBFuture *future = future_create(FUTURE_KEY_ARRAY);
+  Table *table = &tr->store->table;
+  int64_t bytes = 0;
+  int capacity = 0;
+  int i;
+  int end;
+
+  future_push_key(future, &capacity, begin_key_name, begin_key_name_length);
+  pthread_rwlock_rdlock(&tr->store->lock);
+  i = table_lower_bound(table, begin_key_name, begin_key_name_length);
+  end = table_lower_bound(table, end_key_name, end_key_name_length);
+  for (; i < end; i++) {
+    Entry *entry = &table->entries[i];
+    if (bytes >= chunk_size) {
+      future_push_key(future, &capacity, entry->key, entry->key_length);
+      bytes = 0;
+    }
+    bytes += entry->key_length + entry->value_length;
+  }
+  pthread_rwlock_unlock(&tr->store->lock);
+  future_push_key(future, &capacity, end_key_name, end_key_name_length);
+  return future_schedule(future);
+}
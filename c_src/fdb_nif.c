@@ -159,6 +159,26 @@ get_error_predicate(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]) {
   }
 }
 
+/* Counters of the live resources and of the bytes they hold, exposed
+ * through stats/0. The resources are created and destroyed from
+ * schedulers and the network thread, hence the atomic updates. */
+typedef struct {
+  long databases;
+  long tenants;
+  long transactions;
+  long futures;
+  long callbacks;
+  long resource_binary_bytes;
+  long databases_created;
+  long transactions_created;
+  long futures_created;
+} Stats;
+
+static Stats stats;
+
+#define STATS_ADD(F, N) __atomic_add_fetch(&stats.F, (N), __ATOMIC_RELAXED)
+#define STATS_GET(F) __atomic_load_n(&stats.F, __ATOMIC_RELAXED)
+
 typedef enum { RESOURCE } ReferenceType;
 
 typedef struct Reference {
@@ -207,7 +227,8 @@ typedef enum {
   STRING_ARRAY,
   WATCH,
   ERROR,
-  KEY_ARRAY
+  KEY_ARRAY,
+  MAPPED_KEYVALUE_ARRAY
 } FutureType;
 
 static ErlNifResourceType *FUTURE_RESOURCE_TYPE;
@@ -216,6 +237,7 @@ typedef struct {
   FutureType type;
   Reference *reference;
   void *context;
+  long binary_bytes;
 } Future;
 
 static void
@@ -223,6 +245,8 @@ future_destroy(ErlNifEnv *env, void *object) {
   Future *future = (Future *)object;
   fdb_future_destroy(future->handle);
   reference_destroy_all(future->reference);
+  STATS_ADD(futures, -1);
+  STATS_ADD(resource_binary_bytes, -future->binary_bytes);
 }
 
 static ERL_NIF_TERM
@@ -234,6 +258,9 @@ fdb_future_to_future(ErlNifEnv *env, FDBFuture *fdb_future, FutureType type,
   future->type = type;
   future->reference = reference;
   future->context = context;
+  future->binary_bytes = 0;
+  STATS_ADD(futures, 1);
+  STATS_ADD(futures_created, 1);
   term = enif_make_resource(env, future);
   enif_release_resource(future);
   return term;
@@ -248,6 +275,7 @@ static void
 database_destroy(ErlNifEnv *env, void *object) {
   Database *database = (Database *)object;
   fdb_database_destroy(database->handle);
+  STATS_ADD(databases, -1);
 }
 
 static ERL_NIF_TERM
@@ -256,16 +284,46 @@ fdb_database_to_database(ErlNifEnv *env, FDBDatabase *fdb_database) {
   Database *database =
       enif_alloc_resource(DATABASE_RESOURCE_TYPE, sizeof(Database));
   database->handle = fdb_database;
+  STATS_ADD(databases, 1);
+  STATS_ADD(databases_created, 1);
   term = enif_make_resource(env, database);
   enif_release_resource(database);
   return term;
 }
 
+static ErlNifResourceType *TENANT_RESOURCE_TYPE;
+typedef struct {
+  FDBTenant *handle;
+  Reference *reference;
+} Tenant;
+
+static void
+tenant_destroy(ErlNifEnv *env, void *object) {
+  Tenant *tenant = (Tenant *)object;
+  fdb_tenant_destroy(tenant->handle);
+  reference_destroy_all(tenant->reference);
+  STATS_ADD(tenants, -1);
+}
+
+static ERL_NIF_TERM
+fdb_tenant_to_tenant(ErlNifEnv *env, FDBTenant *fdb_tenant,
+                     Reference *reference) {
+  ERL_NIF_TERM term;
+  Tenant *tenant = enif_alloc_resource(TENANT_RESOURCE_TYPE, sizeof(Tenant));
+  tenant->handle = fdb_tenant;
+  tenant->reference = reference;
+  STATS_ADD(tenants, 1);
+  term = enif_make_resource(env, tenant);
+  enif_release_resource(tenant);
+  return term;
+}
+
 static void
 transaction_destroy(ErlNifEnv *env, void *object) {
   Transaction *transaction = (Transaction *)object;
   fdb_transaction_destroy(transaction->handle);
   reference_destroy_all(transaction->reference);
+  STATS_ADD(transactions, -1);
 }
 
 static ERL_NIF_TERM
@@ -276,11 +334,23 @@ fdb_transaction_to_transaction(ErlNifEnv *env, FDBTransaction *fdb_transaction,
       enif_alloc_resource(TRANSACTION_RESOURCE_TYPE, sizeof(Transaction));
   transaction->handle = fdb_transaction;
   transaction->reference = reference;
+  STATS_ADD(transactions, 1);
+  STATS_ADD(transactions_created, 1);
   term = enif_make_resource(env, transaction);
   enif_release_resource(transaction);
   return term;
 }
 
+/* The binaries share the memory of the future, which is kept alive
+ * till the last of them is garbage collected. */
+static ERL_NIF_TERM
+make_future_binary(ErlNifEnv *env, Future *future, const void *data,
+                   size_t size) {
+  future->binary_bytes += size;
+  STATS_ADD(resource_binary_bytes, size);
+  return enif_make_resource_binary(env, future, data, size);
+}
+
 static fdb_error_t
 future_get(ErlNifEnv *env, Future *future, ERL_NIF_TERM *term) {
   fdb_error_t error;
@@ -302,7 +372,7 @@ future_get(ErlNifEnv *env, Future *future, ERL_NIF_TERM *term) {
       return error;
     }
     if (present) {
-      *term = enif_make_resource_binary(env, future, value, value_length);
+      *term = make_future_binary(env, future, value, value_length);
     } else {
       *term = make_atom(env, "nil");
     }
@@ -329,9 +399,9 @@ future_get(ErlNifEnv *env, Future *future, ERL_NIF_TERM *term) {
     list = enif_make_list(env, 0);
     for (i = 0; i < out_count; i++) {
       FDBKeyValue key_value = out_kv[i];
-      ERL_NIF_TERM key = enif_make_resource_binary(env, future, key_value.key,
-                                                   key_value.key_length);
-      ERL_NIF_TERM value = enif_make_resource_binary(
+      ERL_NIF_TERM key = make_future_binary(env, future, key_value.key,
+                                            key_value.key_length);
+      ERL_NIF_TERM value = make_future_binary(
           env, future, key_value.value, key_value.value_length);
       list = enif_make_list_cell(env, enif_make_tuple2(env, key, value), list);
     }
@@ -340,6 +410,50 @@ future_get(ErlNifEnv *env, Future *future, ERL_NIF_TERM *term) {
     *term = enif_make_tuple2(env, enif_make_int(env, out_more), result_list);
     return error;
   }
+  case MAPPED_KEYVALUE_ARRAY: {
+    FDBMappedKeyValue const *out_kv;
+    int out_count;
+    fdb_bool_t out_more;
+    ERL_NIF_TERM list;
+    ERL_NIF_TERM result_list;
+    int i;
+    int j;
+
+    error = fdb_future_get_mappedkeyvalue_array(future->handle, &out_kv,
+                                                &out_count, &out_more);
+    if (error) {
+      return error;
+    }
+
+    list = enif_make_list(env, 0);
+    for (i = 0; i < out_count; i++) {
+      FDBMappedKeyValue mapped = out_kv[i];
+      ERL_NIF_TERM key = make_future_binary(env, future, mapped.key.key,
+                                            mapped.key.key_length);
+      ERL_NIF_TERM value = make_future_binary(
+          env, future, mapped.value.key, mapped.value.key_length);
+      ERL_NIF_TERM range_list = enif_make_list(env, 0);
+      ERL_NIF_TERM range_result_list;
+
+      for (j = 0; j < mapped.getRange.m_size; j++) {
+        FDBKeyValue key_value = mapped.getRange.data[j];
+        ERL_NIF_TERM range_key = make_future_binary(
+            env, future, key_value.key, key_value.key_length);
+        ERL_NIF_TERM range_value = make_future_binary(
+            env, future, key_value.value, key_value.value_length);
+        range_list = enif_make_list_cell(
+            env, enif_make_tuple2(env, range_key, range_value), range_list);
+      }
+
+      enif_make_reverse_list(env, range_list, &range_result_list);
+      list = enif_make_list_cell(
+          env, enif_make_tuple3(env, key, value, range_result_list), list);
+    }
+
+    enif_make_reverse_list(env, list, &result_list);
+    *term = enif_make_tuple2(env, enif_make_int(env, out_more), result_list);
+    return error;
+  }
   case INT64: {
     int64_t value;
     error = fdb_future_get_int64(future->handle, &value);
@@ -356,7 +470,7 @@ future_get(ErlNifEnv *env, Future *future, ERL_NIF_TERM *term) {
     if (error) {
       return error;
     }
-    *term = enif_make_resource_binary(env, future, key, key_length);
+    *term = make_future_binary(env, future, key, key_length);
     return error;
   }
   case STRING_ARRAY: {
@@ -376,7 +490,7 @@ future_get(ErlNifEnv *env, Future *future, ERL_NIF_TERM *term) {
     for (i = 0; i < out_count; i++) {
       const char *string = out_strings[i];
       ERL_NIF_TERM string_term =
-          enif_make_resource_binary(env, future, string, strlen(string));
+          make_future_binary(env, future, string, strlen(string));
       list = enif_make_list_cell(env, string_term, list);
     }
 
@@ -408,7 +522,7 @@ future_get(ErlNifEnv *env, Future *future, ERL_NIF_TERM *term) {
     for (i = 0; i < out_count; i++) {
       FDBKey key = out_keys[i];
       ERL_NIF_TERM key_term =
-          enif_make_resource_binary(env, future, key.key, key.key_length);
+          make_future_binary(env, future, key.key, key.key_length);
       list = enif_make_list_cell(env, key_term, list);
     }
 
@@ -450,6 +564,7 @@ future_callback(FDBFuture *fdb_future, void *argv) {
   enif_free(callback_arg->pid);
   enif_free_env(env);
   enif_free(callback_arg);
+  STATS_ADD(callbacks, -1);
 }
 
 static ERL_NIF_TERM
@@ -475,6 +590,7 @@ future_resolve(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]) {
   enif_keep_resource(future);
   callback_arg->future = future;
   VERIFY(enif_self(env, callback_arg->pid), "self");
+  STATS_ADD(callbacks, 1);
   error =
       fdb_future_set_callback(future->handle, future_callback, callback_arg);
   return enif_make_int(env, error);
@@ -495,6 +611,30 @@ future_is_ready(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]) {
   }
 }
 
+static void
+stats_put(ErlNifEnv *env, ERL_NIF_TERM *map, const char *key, long value) {
+  enif_make_map_put(env, *map, make_atom(env, key), enif_make_long(env, value),
+                    map);
+}
+
+static ERL_NIF_TERM
+get_stats(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]) {
+  ERL_NIF_TERM map = enif_make_new_map(env);
+
+  stats_put(env, &map, "databases", STATS_GET(databases));
+  stats_put(env, &map, "tenants", STATS_GET(tenants));
+  stats_put(env, &map, "transactions", STATS_GET(transactions));
+  stats_put(env, &map, "futures", STATS_GET(futures));
+  stats_put(env, &map, "callbacks", STATS_GET(callbacks));
+  stats_put(env, &map, "resource_binary_bytes",
+            STATS_GET(resource_binary_bytes));
+  stats_put(env, &map, "databases_created", STATS_GET(databases_created));
+  stats_put(env, &map, "transactions_created",
+            STATS_GET(transactions_created));
+  stats_put(env, &map, "futures_created", STATS_GET(futures_created));
+  return map;
+}
+
 static ERL_NIF_TERM
 create_database(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]) {
   char *path = NULL;
@@ -562,6 +702,50 @@ database_create_transaction(ErlNifEnv *env, int argc,
   return enif_make_tuple2(env, enif_make_int(env, error), result);
 }
 
+static ERL_NIF_TERM
+database_open_tenant(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]) {
+  Database *database;
+  ErlNifBinary name;
+  FDBTenant *fdb_tenant;
+  Reference *reference;
+  fdb_error_t error;
+  ERL_NIF_TERM result;
+  VERIFY_ARGV(enif_get_resource(env, argv[0], DATABASE_RESOURCE_TYPE,
+                                (void **)&database),
+              "database");
+  VERIFY_ARGV(enif_inspect_binary(env, argv[1], &name), "name");
+  error = fdb_database_open_tenant(database->handle, name.data, name.size,
+                                   &fdb_tenant);
+  if (error) {
+    return enif_make_tuple2(env, enif_make_int(env, error),
+                            make_atom(env, "nil"));
+  }
+  reference = reference_resource_create(database, NULL);
+  result = fdb_tenant_to_tenant(env, fdb_tenant, reference);
+  return enif_make_tuple2(env, enif_make_int(env, error), result);
+}
+
+static ERL_NIF_TERM
+tenant_create_transaction(ErlNifEnv *env, int argc,
+                          const ERL_NIF_TERM argv[]) {
+  Tenant *tenant;
+  FDBTransaction *fdb_transaction;
+  Reference *reference;
+  fdb_error_t error;
+  ERL_NIF_TERM result;
+  VERIFY_ARGV(enif_get_resource(env, argv[0], TENANT_RESOURCE_TYPE,
+                                (void **)&tenant),
+              "tenant");
+  error = fdb_tenant_create_transaction(tenant->handle, &fdb_transaction);
+  if (error) {
+    return enif_make_tuple2(env, enif_make_int(env, error),
+                            make_atom(env, "nil"));
+  }
+  reference = reference_resource_create(tenant, NULL);
+  result = fdb_transaction_to_transaction(env, fdb_transaction, reference);
+  return enif_make_tuple2(env, enif_make_int(env, error), result);
+}
+
 static ERL_NIF_TERM
 transaction_set_option(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]) {
   Transaction *transaction;
@@ -767,6 +951,67 @@ transaction_get_range(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]) {
   return fdb_future_to_future(env, fdb_future, KEYVALUE_ARRAY, reference, NULL);
 }
 
+static ERL_NIF_TERM
+transaction_get_mapped_range(ErlNifEnv *env, int argc,
+                             const ERL_NIF_TERM argv[]) {
+  Transaction *transaction;
+  FDBFuture *fdb_future;
+  Reference *reference = NULL;
+
+  ERL_NIF_TERM begin_key_term = argv[1];
+  fdb_bool_t begin_or_equal;
+  int begin_offset;
+
+  ERL_NIF_TERM end_key_term = argv[4];
+  fdb_bool_t end_or_equal;
+  int end_offset;
+
+  ERL_NIF_TERM mapper_term = argv[7];
+
+  int limit;
+  int target_bytes;
+
+  int mode;
+  int iteration;
+  fdb_bool_t snapshot;
+  fdb_bool_t reverse;
+
+  ErlNifBinary begin_key;
+  ErlNifBinary end_key;
+  ErlNifBinary mapper;
+
+  VERIFY_ARGV(enif_get_resource(env, argv[0], TRANSACTION_RESOURCE_TYPE,
+                                (void **)&transaction),
+              "transaction");
+  VERIFY_ARGV(enif_is_binary(env, begin_key_term), "begin_key");
+  VERIFY_ARGV(enif_get_int(env, argv[2], &begin_or_equal), "begin_or_equal");
+  VERIFY_ARGV(enif_get_int(env, argv[3], &begin_offset), "begin_offset");
+  VERIFY_ARGV(enif_is_binary(env, end_key_term), "end_key");
+  VERIFY_ARGV(enif_get_int(env, argv[5], &end_or_equal), "end_or_equal");
+  VERIFY_ARGV(enif_get_int(env, argv[6], &end_offset), "end_offset");
+  VERIFY_ARGV(enif_is_binary(env, mapper_term), "mapper");
+  VERIFY_ARGV(enif_get_int(env, argv[8], &limit), "limit");
+  VERIFY_ARGV(enif_get_int(env, argv[9], &target_bytes), "target_bytes");
+  VERIFY_ARGV(enif_get_int(env, argv[10], &mode), "mode");
+  VERIFY_ARGV(enif_get_int(env, argv[11], &iteration), "iteration");
+  VERIFY_ARGV(enif_get_int(env, argv[12], &snapshot), "snapshot");
+  VERIFY_ARGV(enif_get_int(env, argv[13], &reverse), "reverse");
+
+  enif_inspect_binary(env, begin_key_term, &begin_key);
+  enif_inspect_binary(env, end_key_term, &end_key);
+  enif_inspect_binary(env, mapper_term, &mapper);
+
+  fdb_future = fdb_transaction_get_mapped_range(
+      transaction->handle, begin_key.data, begin_key.size, begin_or_equal,
+      begin_offset, end_key.data, end_key.size, end_or_equal, end_offset,
+      mapper.data, mapper.size, limit, target_bytes, (FDBStreamingMode)mode,
+      iteration, snapshot, reverse);
+
+  reference = reference_resource_create(transaction, NULL);
+  return fdb_future_to_future(env, fdb_future, MAPPED_KEYVALUE_ARRAY, reference,
+                              NULL);
+}
+
 static ERL_NIF_TERM
 transaction_get_range_split_points(ErlNifEnv *env, int argc,
                                    const ERL_NIF_TERM argv[]) {
@@ -1025,6 +1270,10 @@ load(ErlNifEnv *env, void **priv_data, ERL_NIF_TERM load_info) {
       env, "fdb", "Database", database_destroy, flags, NULL);
   if (DATABASE_RESOURCE_TYPE == NULL)
     return -1;
+  TENANT_RESOURCE_TYPE = enif_open_resource_type(env, "fdb", "Tenant",
+                                                 tenant_destroy, flags, NULL);
+  if (TENANT_RESOURCE_TYPE == NULL)
+    return -1;
   TRANSACTION_RESOURCE_TYPE = enif_open_resource_type(
       env, "fdb", "Transaction", transaction_destroy, flags, NULL);
   if (TRANSACTION_RESOURCE_TYPE == NULL)
@@ -1046,10 +1295,13 @@ static ErlNifFunc nif_funcs[] = {
     {"transaction_set_option", 2, transaction_set_option, 0},
     {"transaction_set_option", 3, transaction_set_option, 0},
     {"get_error", 1, get_error, 0},
+    {"stats", 0, get_stats, 0},
     {"get_error_predicate", 2, get_error_predicate, 0},
     {"future_resolve", 2, future_resolve, 0},
     {"future_is_ready", 1, future_is_ready, 0},
     {"database_create_transaction", 1, database_create_transaction, 0},
+    {"database_open_tenant", 2, database_open_tenant, 0},
+    {"tenant_create_transaction", 1, tenant_create_transaction, 0},
     {"transaction_get", 3, transaction_get, 0},
     {"transaction_get_read_version", 1, transaction_get_read_version, 0},
     {"transaction_get_approximate_size", 1, transaction_get_approximate_size,
@@ -1058,6 +1310,7 @@ static ErlNifFunc nif_funcs[] = {
     {"transaction_get_addresses_for_key", 2, transaction_get_addresses_for_key,
      0},
     {"transaction_get_range", 13, transaction_get_range, 0},
+    {"transaction_get_mapped_range", 14, transaction_get_mapped_range, 0},
     {"transaction_get_range_split_points", 4, transaction_get_range_split_points, 0},
     {"transaction_set", 3, transaction_set, 0},
     {"transaction_set_read_version", 2, transaction_set_read_version, 0},
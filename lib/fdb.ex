@@ -6,6 +6,7 @@ defmodule FDB do
   alias FDB.Network
   alias FDB.Native
   alias FDB.Utils
+  alias FDB.Telemetry
 
   @doc """
   Sets the [API
@@ -30,4 +31,32 @@ defmodule FDB do
     Native.select_api_version_impl(version, 710)
     |> Utils.verify_ok()
   end
+
+  @doc """
+  Returns the counters of the native resources.
+
+  * `:databases`, `:tenants`, `:transactions`, `:futures` - number of
+    resources alive, not yet garbage collected.
+  * `:callbacks` - number of futures being awaited.
+  * `:resource_binary_bytes` - bytes of the results (keys, values etc)
+    held by the futures alive. The binaries returned by the reads
+    point to the memory of the future, which is freed only after all
+    of them are garbage collected.
+  * `:databases_created`, `:transactions_created`, `:futures_created` -
+    number of resources created since the library was loaded.
+  """
+  @spec stats() :: %{atom => non_neg_integer}
+  def stats do
+    Native.stats()
+  end
+
+  @doc """
+  Emits a `[:fdb, :native, :stats]` telemetry event with `stats/0` as
+  the measurements. Meant to be called periodically, for example as a
+  `:telemetry_poller` measurement `{FDB, :report_stats, []}`.
+  """
+  @spec report_stats() :: :ok
+  def report_stats do
+    Telemetry.execute([:fdb, :native, :stats], stats())
+  end
 end
@@ -0,0 +1,300 @@
+defmodule FDB.Blob do
+  @moduledoc """
+  Stores values larger than the value size limit as fixed size chunks.
+
+      blobs = FDB.Blob.new("files", %{chunk_size: 10_000})
+
+      FDB.Database.transact(db, fn t ->
+        FDB.Blob.put(t, blobs, "avatar.png", data)
+      end)
+
+      :ok = FDB.Blob.write(db, blobs, "backup.tar", File.stream!("backup.tar", [], 65_536))
+
+      FDB.Blob.stream(db, blobs, "backup.tar", %{offset: 1_000_000, length: 4096})
+      |> Enum.into(File.stream!("part"))
+
+  A blob is stored as a header `{name}`, which holds the size, the
+  chunk size and a random id, and the chunks `{name, id, index}`. The
+  header is written last, so a blob is either fully visible or not at
+  all. `put/4` writes the whole blob in one transaction, which is
+  limited to 10MB. `write/5` spreads the chunks across as many
+  transactions as needed and swaps the header in the last one. If it
+  fails midway, the chunks already written are not visible and are
+  removed by the next `delete/3` of the same name.
+
+  `get/3` fetches the chunks with a single range read. `stream/4`
+  fetches `concurrency` chunks at a time with parallel reads and emits
+  them one by one, so the whole value is never held in memory. It also
+  supports reading a byte range.
+  """
+  alias FDB.{Database, Transaction, KeyRange, KeySelectorRange, Future, Option}
+  alias FDB.Coder.{Subspace, Tuple, Integer, ByteString}
+
+  defstruct [:headers, :chunks, :chunk_size]
+
+  @type t :: %__MODULE__{}
+
+  @max_chunk_size 100_000
+
+  @doc """
+  Creates a blob store under the given prefix. The prefix can be a raw
+  binary or a directory.
+
+  ## Options
+
+  * `:key_coder` - (`t:FDB.Coder.t/0`) the coder of the blob name,
+    should be one of the tuple element coders. Defaults to
+    `FDB.Coder.ByteString.new()`.
+  * `:chunk_size` - (integer) size of a chunk in bytes, at most
+    `100_000`. Defaults to `10_000`.
+  """
+  @spec new(binary | FDB.Directory.t(), map) :: t
+  def new(prefix, options \\ %{}) do
+    key_coder = Map.get(options, :key_coder, ByteString.new())
+    chunk_size = Map.get(options, :chunk_size, 10_000)
+
+    unless is_integer(chunk_size) and chunk_size > 0 and chunk_size <= @max_chunk_size do
+      raise ArgumentError, "Invalid chunk_size: #{inspect(chunk_size)}"
+    end
+
+    headers =
+      Transaction.Coder.new(
+        Subspace.new(prefix, Tuple.new({key_coder})),
+        Tuple.new({Integer.new(), Integer.new(), ByteString.new()})
+      )
+
+    chunks =
+      Transaction.Coder.new(
+        Subspace.new(prefix, Tuple.new({key_coder, ByteString.new(), Integer.new()}))
+      )
+
+    %__MODULE__{headers: headers, chunks: chunks, chunk_size: chunk_size}
+  end
+
+  @doc """
+  Writes the blob in the given transaction, replacing the existing
+  one.
+  """
+  @spec put(Transaction.t(), t, any, binary) :: :ok
+  def put(%Transaction{} = transaction, %__MODULE__{} = blob, name, data) when is_binary(data) do
+    :ok = delete(transaction, blob, name)
+    id = new_id()
+
+    split(data, blob.chunk_size)
+    |> Enum.with_index()
+    |> Enum.each(fn {chunk, index} ->
+      :ok = Transaction.set(transaction, {name, id, index}, chunk, %{coder: blob.chunks})
+    end)
+
+    set_header(transaction, blob, name, {byte_size(data), blob.chunk_size, id})
+  end
+
+  @doc """
+  Writes the blob using multiple transactions, replacing the existing
+  one. `data` is either a binary or an enumerable of binaries of any
+  size, which is consumed lazily.
+
+  The existing blob stays readable until the last transaction, which
+  swaps the header and clears the old chunks.
+
+  ## Options
+
+  * `:batch_bytes` - (integer) approximate number of bytes written per
+    transaction. Defaults to `1_000_000`.
+  """
+  @spec write(Database.t(), t, any, binary | Enumerable.t(), map) :: :ok
+  def write(%Database{} = database, %__MODULE__{} = blob, name, data, options \\ %{}) do
+    data = if is_binary(data), do: [data], else: data
+    per_transaction = max(div(Map.get(options, :batch_bytes, 1_000_000), blob.chunk_size), 1)
+    id = new_id()
+
+    size =
+      data
+      |> Stream.chunk_while("", &rechunk(&2 <> &1, blob.chunk_size, []), fn
+        "" -> {:cont, ""}
+        rest -> {:cont, [rest], ""}
+      end)
+      |> Stream.flat_map(& &1)
+      |> Stream.with_index()
+      |> Stream.chunk_every(per_transaction)
+      |> Enum.reduce(0, fn chunks, size ->
+        Database.transact(database, fn t ->
+          Enum.reduce(chunks, size, fn {chunk, index}, size ->
+            :ok = Transaction.set(t, {name, id, index}, chunk, %{coder: blob.chunks})
+            size + byte_size(chunk)
+          end)
+        end)
+      end)
+
+    Database.transact(database, fn t ->
+      case header(t, blob, name) do
+        nil ->
+          :ok
+
+        {_size, _chunk_size, old_id} ->
+          range = KeyRange.starts_with({name, old_id})
+          :ok = Transaction.clear_range(t, range, %{coder: blob.chunks})
+      end
+
+      set_header(t, blob, name, {size, blob.chunk_size, id})
+    end)
+  end
+
+  defp rechunk(data, chunk_size, acc) when byte_size(data) >= chunk_size do
+    <<chunk::binary-size(chunk_size), rest::binary>> = data
+    rechunk(rest, chunk_size, [chunk | acc])
+  end
+
+  defp rechunk(rest, _chunk_size, []), do: {:cont, rest}
+  defp rechunk(rest, _chunk_size, acc), do: {:cont, Enum.reverse(acc), rest}
+
+  defp split(<<>>, _chunk_size), do: []
+
+  defp split(data, chunk_size) when byte_size(data) <= chunk_size, do: [data]
+
+  defp split(data, chunk_size) do
+    <<chunk::binary-size(chunk_size), rest::binary>> = data
+    [chunk | split(rest, chunk_size)]
+  end
+
+  defp new_id, do: :crypto.strong_rand_bytes(8)
+
+  defp set_header(transaction, blob, name, header) do
+    Transaction.set(transaction, {name}, header, %{coder: blob.headers})
+  end
+
+  defp header(transaction, blob, name) do
+    Transaction.get(transaction, {name}, %{coder: blob.headers})
+  end
+
+  @doc """
+  Returns the blob or `nil` if it doesn't exist. The whole blob is
+  read with a single range read, use `stream/4` for large blobs.
+  """
+  @spec get(Transaction.t(), t, any) :: binary | nil
+  def get(%Transaction{} = transaction, %__MODULE__{} = blob, name) do
+    case header(transaction, blob, name) do
+      nil ->
+        nil
+
+      {_size, _chunk_size, id} ->
+        Transaction.get_range_stream(transaction, KeySelectorRange.starts_with({name, id}), %{
+          coder: blob.chunks,
+          mode: Option.streaming_mode_want_all()
+        })
+        |> Enum.map(fn {_key, chunk} -> chunk end)
+        |> IO.iodata_to_binary()
+    end
+  end
+
+  @doc """
+  Returns the size of the blob in bytes or `nil` if it doesn't exist.
+  """
+  @spec size(Database.t() | Transaction.t(), t, any) :: non_neg_integer | nil
+  def size(%Database{} = database, %__MODULE__{} = blob, name) do
+    Database.transact(database, fn t -> size(t, blob, name) end)
+  end
+
+  def size(%Transaction{} = transaction, %__MODULE__{} = blob, name) do
+    case header(transaction, blob, name) do
+      nil -> nil
+      {size, _chunk_size, _id} -> size
+    end
+  end
+
+  @doc """
+  Deletes the blob along with the chunks left behind by failed
+  `write/5` calls.
+  """
+  @spec delete(Transaction.t(), t, any) :: :ok
+  def delete(%Transaction{} = transaction, %__MODULE__{} = blob, name) do
+    :ok = Transaction.clear(transaction, {name}, %{coder: blob.headers})
+    Transaction.clear_range(transaction, KeyRange.starts_with({name}), %{coder: blob.chunks})
+  end
+
+  @doc """
+  Returns a stream of binaries which together make up the blob or the
+  requested byte range of it. The stream is empty if the blob doesn't
+  exist.
+
+  With a database, each batch of chunks is read in its own
+  transaction, so the stream is not limited by the transaction
+  lifetime. If the blob is replaced or deleted while it's being
+  streamed, the stream raises.
+
+  ## Options
+
+  * `:offset` - (integer) Defaults to `0`.
+  * `:length` - (integer) maximum number of bytes to read. Defaults to
+    the rest of the blob.
+  * `:concurrency` - (integer) number of chunks read in parallel.
+    Defaults to `8`.
+  """
+  @spec stream(Database.t() | Transaction.t(), t, any, map) :: Enumerable.t()
+  def stream(database_or_transaction, %__MODULE__{} = blob, name, options \\ %{}) do
+    offset = Map.get(options, :offset, 0)
+    concurrency = Map.get(options, :concurrency, 8)
+
+    Stream.unfold(:start, fn
+      :start ->
+        case with_transaction(database_or_transaction, &header(&1, blob, name)) do
+          nil ->
+            nil
+
+          {size, chunk_size, _id} = header ->
+            stop = min(size, offset + Map.get(options, :length, size))
+
+            batches =
+              if offset < stop do
+                Enum.chunk_every(div(offset, chunk_size)..div(stop - 1, chunk_size), concurrency)
+              else
+                []
+              end
+
+            {[], {header, {offset, stop}, batches}}
+        end
+
+      {_header, _range, []} ->
+        nil
+
+      {header, range, [indexes | batches]} ->
+        chunks =
+          with_transaction(database_or_transaction, fn t ->
+            read_chunks(t, blob, name, header, indexes)
+          end)
+
+        {Enum.map(chunks, &slice(&1, header, range)), {header, range, batches}}
+    end)
+    |> Stream.flat_map(& &1)
+  end
+
+  defp with_transaction(%Database{} = database, callback),
+    do: Database.transact(database, callback)
+
+  defp with_transaction(%Transaction{} = transaction, callback), do: callback.(transaction)
+
+  defp read_chunks(transaction, blob, name, {_size, _chunk_size, id} = header, indexes) do
+    header_future = Transaction.get_q(transaction, {name}, %{coder: blob.headers})
+
+    chunks =
+      Enum.map(indexes, fn index ->
+        Transaction.get_q(transaction, {name, id, index}, %{coder: blob.chunks})
+        |> Future.map(&{index, &1})
+      end)
+      |> Future.all()
+      |> Future.await()
+
+    if Future.await(header_future) != header || Enum.any?(chunks, &(elem(&1, 1) == nil)) do
+      raise "Blob #{inspect(name)} was modified while streaming"
+    end
+
+    chunks
+  end
+
+  defp slice({index, chunk}, {_size, chunk_size, _id}, {offset, stop}) do
+    chunk_start = index * chunk_size
+    from = max(offset - chunk_start, 0)
+    to = min(stop - chunk_start, byte_size(chunk))
+    binary_part(chunk, from, to - from)
+  end
+end
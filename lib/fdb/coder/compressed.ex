@@ -0,0 +1,222 @@
+defmodule FDB.Coder.Compressed do
+  @moduledoc """
+  Compresses the values encoded by the inner coder with deflate. This
+  should be only used as a value coder.
+
+      coder = FDB.Coder.Compressed.new(FDB.Coder.Identity.new(), %{threshold: 256})
+
+  Values smaller than the `threshold` or which don't get smaller when
+  compressed are stored as is, with a one byte header. Decoding them
+  returns a sub binary of the stored value, the data is not copied.
+
+  Small values compress much better with a preset dictionary, a
+  binary which contains the strings that are common across the values
+  (the keys of JSON objects, atoms of ETF etc). Dictionaries are
+  identified by a version, which is stored along with each compressed
+  value, so that values compressed with an older dictionary can be
+  decoded after a new one is rolled out. The dictionaries can be
+  stored in the database with `put_dictionary/4`.
+
+      FDB.Database.transact(db, fn t ->
+        FDB.Coder.Compressed.put_dictionary(t, "dictionaries", 1, dictionary)
+      end)
+
+      dictionaries =
+        FDB.Database.transact(db, fn t ->
+          FDB.Coder.Compressed.get_dictionaries(t, "dictionaries")
+        end)
+
+      coder = FDB.Coder.Compressed.new(inner, %{dictionaries: dictionaries})
+
+  The zlib streams are opened once per process and reset between
+  values, only the dictionary is set again for each value.
+  """
+  use FDB.Coder.Behaviour
+  alias FDB.Transaction
+  alias FDB.KeySelectorRange
+  alias FDB.Coder.{Subspace, Tuple, Integer, Identity}
+
+  @raw 0x00
+  @deflate 0x01
+  @deflate_dictionary 0x02
+
+  @doc """
+  ## Options
+
+  * `:threshold` - (integer) values smaller than this many bytes are
+    not compressed. Defaults to `64`.
+  * `:level` - compression level, refer `:zlib.deflateInit/2`.
+    Defaults to `:default`.
+  * `:dictionaries` - (map) dictionary version to dictionary. Defaults to `%{}`.
+  * `:version` - (integer) version of the dictionary used to compress
+    the values. Defaults to the largest version in `:dictionaries`.
+  * `:max_size` - (integer) decoding a value which decompresses to
+    more than this many bytes raises `ArgumentError`. Defaults to
+    `10_000_000`.
+  """
+  @spec new(FDB.Coder.t(), map) :: FDB.Coder.t()
+  def new(coder, options \\ %{}) do
+    dictionaries = Map.get(options, :dictionaries, %{})
+
+    version =
+      Map.get_lazy(options, :version, fn ->
+        if map_size(dictionaries) > 0, do: Enum.max(Map.keys(dictionaries))
+      end)
+
+    if version != nil && !Map.has_key?(dictionaries, version) do
+      raise ArgumentError, "Unknown dictionary version: #{inspect(version)}"
+    end
+
+    %FDB.Coder{
+      module: __MODULE__,
+      opts: %{
+        coder: coder,
+        threshold: Map.get(options, :threshold, 64),
+        level: Map.get(options, :level, :default),
+        version: version,
+        dictionaries: dictionaries,
+        max_size: Map.get(options, :max_size, 10_000_000)
+      }
+    }
+  end
+
+  @impl true
+  def encode(value, %{coder: coder} = opts) do
+    data = coder.module.encode(value, coder.opts)
+
+    if byte_size(data) < opts.threshold do
+      <<@raw, data::binary>>
+    else
+      compressed =
+        case opts.version do
+          nil ->
+            <<@deflate, deflate(data, opts.level, nil)::binary>>
+
+          version ->
+            dictionary = Map.fetch!(opts.dictionaries, version)
+
+            <<@deflate_dictionary, version::unsigned-big-integer-size(32),
+              deflate(data, opts.level, dictionary)::binary>>
+        end
+
+      if byte_size(compressed) <= byte_size(data) do
+        compressed
+      else
+        <<@raw, data::binary>>
+      end
+    end
+  end
+
+  @impl true
+  def decode(<<@raw, data::binary>>, %{coder: coder}) do
+    coder.module.decode(data, coder.opts)
+  end
+
+  def decode(<<@deflate, data::binary>>, %{coder: coder} = opts) do
+    coder.module.decode(inflate(data, nil, opts.max_size), coder.opts)
+  end
+
+  def decode(
+        <<@deflate_dictionary, version::unsigned-big-integer-size(32), data::binary>>,
+        %{coder: coder} = opts
+      ) do
+    dictionary =
+      case Map.fetch(opts.dictionaries, version) do
+        {:ok, dictionary} -> dictionary
+        :error -> raise ArgumentError, "Unknown dictionary version: #{version}"
+      end
+
+    coder.module.decode(inflate(data, dictionary, opts.max_size), coder.opts)
+  end
+
+  @impl true
+  def range(nil, _), do: {<<>>, <<>>}
+  def range(_, _), do: raise(ArgumentError, "Compressed coder can't be used as a key coder")
+
+  defp deflate(data, level, dictionary) do
+    z =
+      stream(
+        {:deflate, level},
+        &:zlib.deflateInit(&1, level, :deflated, -15, 8, :default),
+        &:zlib.deflateReset/1
+      )
+
+    if dictionary do
+      :zlib.deflateSetDictionary(z, dictionary)
+    end
+
+    IO.iodata_to_binary(:zlib.deflate(z, data, :finish))
+  end
+
+  defp inflate(data, dictionary, max_size) do
+    z = stream(:inflate, &:zlib.inflateInit(&1, -15), &:zlib.inflateReset/1)
+
+    if dictionary do
+      :ok = :zlib.inflateSetDictionary(z, dictionary)
+    end
+
+    inflate_chunks(z, data, [], 0, max_size)
+  end
+
+  defp inflate_chunks(z, data, acc, size, max_size) do
+    {status, output} = :zlib.safeInflate(z, data)
+    size = size + IO.iodata_length(output)
+
+    if size > max_size do
+      raise ArgumentError, "Compressed value is larger than #{max_size} bytes"
+    end
+
+    case status do
+      :finished -> IO.iodata_to_binary(Enum.reverse([output | acc]))
+      :continue -> inflate_chunks(z, [], [output | acc], size, max_size)
+    end
+  end
+
+  # A zlib stream can only be used by the process which opened it, so
+  # one stream of each kind is kept in the process dictionary. It's
+  # reset before every use, which also recovers it from a failed one.
+  defp stream(kind, init, reset) do
+    key = {__MODULE__, kind}
+
+    case Process.get(key) do
+      nil ->
+        z = :zlib.open()
+        :ok = init.(z)
+        Process.put(key, z)
+        z
+
+      z ->
+        :ok = reset.(z)
+        z
+    end
+  end
+
+  @doc """
+  Stores the dictionary under the given prefix. The prefix can be a
+  raw binary or a directory.
+  """
+  @spec put_dictionary(Transaction.t(), binary | FDB.Directory.t(), non_neg_integer, binary) ::
+          :ok
+  def put_dictionary(%Transaction{} = transaction, prefix, version, dictionary)
+      when is_integer(version) and version >= 0 and is_binary(dictionary) do
+    Transaction.set(transaction, {version}, dictionary, %{coder: dictionary_coder(prefix)})
+  end
+
+  @doc """
+  Returns all the dictionaries stored under the given prefix as a map
+  of version to dictionary.
+  """
+  @spec get_dictionaries(Transaction.t(), binary | FDB.Directory.t()) :: %{
+          non_neg_integer => binary
+        }
+  def get_dictionaries(%Transaction{} = transaction, prefix) do
+    Transaction.get_range_stream(transaction, KeySelectorRange.starts_with(nil), %{
+      coder: dictionary_coder(prefix)
+    })
+    |> Map.new(fn {{version}, dictionary} -> {version, dictionary} end)
+  end
+
+  defp dictionary_coder(prefix) do
+    Transaction.Coder.new(Subspace.new(prefix, Tuple.new({Integer.new()})), Identity.new())
+  end
+end
@@ -0,0 +1,166 @@
+defmodule FDB.ConflictTracker do
+  @moduledoc """
+  Keeps track of the key ranges that caused transactions to fail with
+  `not_committed` (1020) error.
+
+  The tracker is enabled per database. `FDB.Database.transact/2`
+  sets `FDB.Option.transaction_option_report_conflicting_keys/0` on
+  the sampled transactions and, after a conflict, reads the
+  conflicting ranges from the `\\xff\\xff/transaction/conflicting_keys/`
+  special key range and records them in the tracker.
+
+      {:ok, tracker} = FDB.ConflictTracker.start_link(capacity: 50)
+      db = FDB.Database.create(nil, %{conflict_tracker: tracker, conflict_sample_rate: 0.1})
+
+      FDB.ConflictTracker.top(tracker, 5)
+      # [%{begin: "counter", end: "counter\\0", count: 12, error: 0}, ...]
+
+  Only the `capacity` most frequent ranges are kept, using the space
+  saving algorithm. The `count` of a range is an over estimate of the
+  actual count by at most `error`. The ranges are raw keys and are not
+  decoded with the database coder.
+
+  If the application depends on
+  [telemetry](https://hex.pm/packages/telemetry), the following events
+  are emitted
+
+  * `[:fdb, :transaction, :conflict]` - for every recorded conflict
+    with measurement `count` (number of ranges) and metadata `ranges`.
+  * `[:fdb, :conflict_tracker, :report]` - every `report_interval`
+    with measurements `conflicts` (number of conflicts recorded since
+    the last report) and metadata `top` (same as `top/2`).
+
+  ## Options
+
+  * `:name` - registers the tracker under the given name.
+  * `:capacity` - number of ranges kept. Defaults to `100`.
+  * `:report_interval` - interval in milliseconds between the report
+    events. `nil` disables the report. Defaults to `60_000`.
+  * `:report_size` - number of ranges included in the report. Defaults
+    to `10`.
+  """
+  use GenServer
+
+  @type range :: {binary, binary}
+  @type entry :: %{begin: binary, end: binary, count: non_neg_integer, error: non_neg_integer}
+
+  @spec start_link(keyword) :: GenServer.on_start()
+  def start_link(opts \\ []) do
+    {name, opts} = Keyword.pop(opts, :name)
+
+    if name do
+      GenServer.start_link(__MODULE__, opts, name: name)
+    else
+      GenServer.start_link(__MODULE__, opts)
+    end
+  end
+
+  @doc """
+  Records the conflicting ranges of a single transaction attempt.
+  """
+  @spec record(GenServer.server(), [range]) :: :ok
+  def record(_tracker, []), do: :ok
+
+  def record(tracker, ranges) when is_list(ranges) do
+    FDB.Telemetry.execute(
+      [:fdb, :transaction, :conflict],
+      %{count: length(ranges)},
+      %{ranges: ranges}
+    )
+
+    GenServer.cast(tracker, {:record, ranges})
+  end
+
+  @doc """
+  Returns the `n` most frequent conflicting ranges, most frequent
+  first.
+  """
+  @spec top(GenServer.server(), pos_integer) :: [entry]
+  def top(tracker, n \\ 10) when is_integer(n) and n > 0 do
+    GenServer.call(tracker, {:top, n})
+  end
+
+  @doc """
+  Clears all the recorded ranges.
+  """
+  @spec reset(GenServer.server()) :: :ok
+  def reset(tracker) do
+    GenServer.call(tracker, :reset)
+  end
+
+  @impl true
+  def init(opts) do
+    state = %{
+      capacity: Keyword.get(opts, :capacity, 100),
+      report_interval: Keyword.get(opts, :report_interval, 60_000),
+      report_size: Keyword.get(opts, :report_size, 10),
+      counts: %{},
+      conflicts: 0
+    }
+
+    schedule_report(state)
+    {:ok, state}
+  end
+
+  @impl true
+  def handle_cast({:record, ranges}, state) do
+    counts = Enum.reduce(ranges, state.counts, &increment(&2, &1, state.capacity))
+    {:noreply, %{state | counts: counts, conflicts: state.conflicts + 1}}
+  end
+
+  @impl true
+  def handle_call({:top, n}, _from, state) do
+    {:reply, top_entries(state.counts, n), state}
+  end
+
+  def handle_call(:reset, _from, state) do
+    {:reply, :ok, %{state | counts: %{}, conflicts: 0}}
+  end
+
+  @impl true
+  def handle_info(:report, state) do
+    FDB.Telemetry.execute(
+      [:fdb, :conflict_tracker, :report],
+      %{conflicts: state.conflicts},
+      %{top: top_entries(state.counts, state.report_size)}
+    )
+
+    schedule_report(state)
+    {:noreply, %{state | conflicts: 0}}
+  end
+
+  defp schedule_report(%{report_interval: nil}), do: :ok
+
+  defp schedule_report(%{report_interval: interval}) do
+    Process.send_after(self(), :report, interval)
+    :ok
+  end
+
+  # Space saving: when the table is full, the least frequent range is
+  # replaced and the new range inherits its count as the error.
+  defp increment(counts, range, capacity) do
+    case counts do
+      %{^range => {count, error}} ->
+        Map.put(counts, range, {count + 1, error})
+
+      _ when map_size(counts) < capacity ->
+        Map.put(counts, range, {1, 0})
+
+      _ ->
+        {min_range, {min_count, _}} = Enum.min_by(counts, fn {_, {count, _}} -> count end)
+
+        counts
+        |> Map.delete(min_range)
+        |> Map.put(range, {min_count + 1, min_count})
+    end
+  end
+
+  defp top_entries(counts, n) do
+    counts
+    |> Enum.sort_by(fn {_, {count, _}} -> count end, &>=/2)
+    |> Enum.take(n)
+    |> Enum.map(fn {{begin_key, end_key}, {count, error}} ->
+      %{begin: begin_key, end: end_key, count: count, error: error}
+    end)
+  end
+end
@@ -0,0 +1,154 @@
+defmodule FDB.Counter do
+  @moduledoc """
+  A counter which supports high rate of increments.
+
+      counter = FDB.Counter.new("page_views", %{shards: 32})
+
+      FDB.Database.transact(db, fn t ->
+        FDB.Counter.add(t, counter, 1)
+      end)
+
+      FDB.Database.transact(db, fn t ->
+        FDB.Counter.get(t, counter, %{snapshot: true})
+      end)
+
+  The increments are done with `FDB.Option.mutation_type_add/0`,
+  which never conflicts. The counter is spread over `shards` keys, so
+  that the increments are not all sent to the storage server which
+  holds a single key.
+
+  The value is the sum of all the shards, read with a single range
+  read. The default read adds a read conflict range over the shards,
+  which matters only if the transaction also writes: an increment
+  committed after the read then makes it fail with `not_committed`
+  error and retry. A read only transaction is not conflict checked, so
+  the value it returns may be stale by the time it's used either way.
+  A read with `snapshot: true` adds no conflict range, use it when the
+  transaction writes something that doesn't depend on the exact value.
+
+  `compact/2` folds the shards into one key. Run it periodically with
+  `FDB.Counter.Compactor` if the shards are many or are written with
+  explicit shard numbers.
+  """
+  alias FDB.{Database, Transaction, KeySelectorRange, Option}
+  alias FDB.Coder.{Subspace, Tuple, Integer, SignedLittleEndianInteger}
+
+  defstruct [:coder, :shards]
+
+  @type t :: %__MODULE__{}
+
+  @doc """
+  Creates a counter stored under the given prefix. The prefix can be a
+  raw binary or a directory.
+
+  ## Options
+
+  * `:shards` - (integer) number of shard keys. Defaults to `16`.
+  """
+  @spec new(binary | FDB.Directory.t(), map) :: t
+  def new(prefix, options \\ %{}) do
+    coder =
+      Transaction.Coder.new(
+        Subspace.new(prefix, Tuple.new({Integer.new()})),
+        SignedLittleEndianInteger.new(64)
+      )
+
+    %__MODULE__{coder: coder, shards: Map.get(options, :shards, 16)}
+  end
+
+  @doc """
+  Adds `delta` to the counter.
+
+  ## Options
+
+  * `:shard` - `:random`, `:scheduler` or a shard number. `:scheduler`
+    picks the shard based on the scheduler the process is running on,
+    which keeps the increments of a process on the same shard.
+    Defaults to `:random`.
+  """
+  @spec add(Transaction.t(), t, integer, map) :: :ok
+  def add(%Transaction{} = transaction, %__MODULE__{} = counter, delta, options \\ %{})
+      when is_integer(delta) do
+    shard = shard(counter, Map.get(options, :shard, :random))
+
+    Transaction.atomic_op(transaction, {shard}, Option.mutation_type_add(), delta, %{
+      coder: counter.coder
+    })
+  end
+
+  defp shard(counter, :random), do: :rand.uniform(counter.shards) - 1
+
+  defp shard(counter, :scheduler),
+    do: rem(:erlang.system_info(:scheduler_id) - 1, counter.shards)
+
+  defp shard(_counter, shard) when is_integer(shard) and shard >= 0, do: shard
+
+  @doc """
+  Returns the value of the counter.
+
+  ## Options
+
+  * `:snapshot` - (boolean) approximate read, refer `FDB.Counter`. Defaults to `false`.
+  """
+  @spec get(Database.t() | Transaction.t(), t, map) :: integer
+  def get(database_or_transaction, counter, options \\ %{})
+
+  def get(%Database{} = database, %__MODULE__{} = counter, options) do
+    Database.transact(database, fn t -> get(t, counter, options) end)
+  end
+
+  def get(%Transaction{} = transaction, %__MODULE__{} = counter, options) do
+    shards(transaction, counter, Map.get(options, :snapshot, false))
+    |> Enum.reduce(0, fn {_shard, value}, sum -> sum + value end)
+  end
+
+  defp shards(transaction, counter, snapshot) do
+    Transaction.get_range_stream(transaction, KeySelectorRange.starts_with(nil), %{
+      coder: counter.coder,
+      snapshot: snapshot,
+      mode: Option.streaming_mode_want_all()
+    })
+    |> Enum.to_list()
+  end
+
+  @doc """
+  Folds all the shards into shard `0`.
+
+  The shards are read with a snapshot read and every shard other than
+  `0` is decremented by the value read, with the same amount added to
+  shard `0`. As only atomic operations are used, the compaction
+  doesn't conflict with concurrent increments. The shards which end up
+  at zero are cleared.
+  """
+  @spec compact(Database.t() | Transaction.t(), t) :: :ok
+  def compact(%Database{} = database, %__MODULE__{} = counter) do
+    Database.transact(database, fn t -> compact(t, counter) end)
+  end
+
+  def compact(%Transaction{} = transaction, %__MODULE__{} = counter) do
+    moved =
+      shards(transaction, counter, true)
+      |> Enum.reject(fn {{shard}, _value} -> shard == 0 end)
+      |> Enum.map(fn {key, value} ->
+        :ok = add(transaction, counter, -value, %{shard: elem(key, 0)})
+
+        :ok =
+          Transaction.atomic_op(
+            transaction,
+            key,
+            Option.mutation_type_compare_and_clear(),
+            0,
+            %{coder: counter.coder}
+          )
+
+        value
+      end)
+      |> Enum.sum()
+
+    if moved != 0 do
+      :ok = add(transaction, counter, moved, %{shard: 0})
+    end
+
+    :ok
+  end
+end
@@ -0,0 +1,77 @@
+defmodule FDB.Counter.Compactor do
+  @moduledoc """
+  Periodically compacts a list of counters, refer `FDB.Counter.compact/2`.
+
+      children = [
+        {FDB.Counter.Compactor, database: db, counters: [views, likes], interval: 60_000}
+      ]
+
+  ## Options
+
+  * `:database` - (`t:FDB.Database.t/0`) required.
+  * `:counters` - ([`t:FDB.Counter.t/0`]) required.
+  * `:interval` - (integer) milliseconds between two compactions. Defaults to `60_000`.
+  * `:name` - registers the compactor under the given name.
+  """
+  use GenServer
+  require Logger
+  alias FDB.Counter
+
+  @spec start_link(keyword) :: GenServer.on_start()
+  def start_link(opts) do
+    {name, opts} = Keyword.pop(opts, :name)
+
+    if name do
+      GenServer.start_link(__MODULE__, opts, name: name)
+    else
+      GenServer.start_link(__MODULE__, opts)
+    end
+  end
+
+  @doc """
+  Compacts all the counters right away.
+  """
+  @spec compact(GenServer.server()) :: :ok
+  def compact(compactor) do
+    GenServer.call(compactor, :compact, :infinity)
+  end
+
+  @impl true
+  def init(opts) do
+    state = %{
+      database: Keyword.fetch!(opts, :database),
+      counters: Keyword.fetch!(opts, :counters),
+      interval: Keyword.get(opts, :interval, 60_000)
+    }
+
+    schedule(state)
+    {:ok, state}
+  end
+
+  @impl true
+  def handle_call(:compact, _from, state) do
+    {:reply, compact_all(state), state}
+  end
+
+  @impl true
+  def handle_info(:compact, state) do
+    compact_all(state)
+    schedule(state)
+    {:noreply, state}
+  end
+
+  defp compact_all(state) do
+    Enum.each(state.counters, fn counter ->
+      try do
+        :ok = Counter.compact(state.database, counter)
+      rescue
+        e in FDB.Error ->
+          Logger.warn("Failed to compact counter: #{Exception.message(e)}")
+      end
+    end)
+  end
+
+  defp schedule(state) do
+    Process.send_after(self(), :compact, state.interval)
+  end
+end
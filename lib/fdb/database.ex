@@ -8,8 +8,11 @@ defmodule FDB.Database do
   alias FDB.Option
   alias FDB.Transaction
   alias FDB.KeySelectorRange
+  alias FDB.RangeResult
+  alias FDB.ConflictTracker
+  alias FDB.Tenant
 
-  defstruct resource: nil, coder: nil
+  defstruct resource: nil, coder: nil, conflict_tracker: nil, conflict_sample_rate: 1.0
 
   @type t :: %__MODULE__{}
 
@@ -75,7 +78,8 @@ defmodule FDB.Database do
   consistency guarantee. This function uses multiple transactions to
   fetch the data. This is advantageous if you want to fetch large
   amount of data and are ok with the fact that the data might change
-  when doing the iteration.
+  when doing the iteration. Use `get_range_snapshot_stream/3` for a
+  consistent view across the batches.
   """
   @spec get_range_stream(t, KeySelectorRange.t(), map) :: Enumerable.t()
   def get_range_stream(
@@ -90,6 +94,77 @@ defmodule FDB.Database do
     )
   end
 
+  @doc """
+  Refer `FDB.Transaction.get_range/3` for options. Like
+  `get_range_stream/3` each batch is fetched in its own transaction,
+  but all the transactions share the read version of the first one,
+  so the batches are read from the same snapshot of the database and
+  only the first batch waits for a read version.
+
+  The stream emits the batches as `{read_version, key_values}`
+  tuples. A read version can be used only for a few seconds (refer
+  `FDB.Option.transaction_option_timeout/0`), if a batch fails with
+  `transaction_too_old` error, the stream continues from where it left
+  off with a new read version. So the stream is consistent across all
+  the batches only if all of them have the same read version.
+
+      Database.get_range_snapshot_stream(db, KeySelectorRange.starts_with("user:"))
+      |> Enum.flat_map(fn {_read_version, key_values} -> key_values end)
+  """
+  @spec get_range_snapshot_stream(t, KeySelectorRange.t(), map) :: Enumerable.t()
+  def get_range_snapshot_stream(
+        %__MODULE__{} = database,
+        %KeySelectorRange{} = key_range,
+        options \\ %{}
+      ) do
+    Stream.unfold(
+      {nil, fn t -> Transaction.get_range(t, key_range, options) end},
+      fn
+        :halt ->
+          nil
+
+        {read_version, next} ->
+          {read_version, range_result} =
+            read_batch(Transaction.create(database), read_version, next)
+
+          case range_result do
+            %RangeResult{has_more: false, key_values: key_values} ->
+              {{read_version, key_values}, :halt}
+
+            %RangeResult{has_more: true, key_values: key_values, next: next} ->
+              {{read_version, key_values}, {read_version, next}}
+          end
+      end
+    )
+  end
+
+  @transaction_too_old 1007
+
+  defp read_batch(%Transaction{} = transaction, read_version, next) do
+    try do
+      read_version =
+        case read_version do
+          nil ->
+            Transaction.get_read_version(transaction)
+
+          read_version ->
+            :ok = Transaction.set_read_version(transaction, read_version)
+            read_version
+        end
+
+      {read_version, next.(transaction)}
+    rescue
+      e in FDB.Error ->
+        :ok = Transaction.on_error(transaction, e.code)
+
+        if e.code == @transaction_too_old do
+          read_batch(transaction, nil, next)
+        else
+          read_batch(transaction, read_version, next)
+        end
+    end
+  end
+
   @doc """
   The given `callback` will be called with a
   `t:FDB.Transaction.t/0`.
@@ -112,19 +187,62 @@ defmodule FDB.Database do
   `FDB.Option.transaction_option_retry_limit/0` etc which control the
   retry behaviour can be configured using
   `FDB.Transaction.set_option/3`
+
+  If the database has a `conflict_tracker` (see
+  `FDB.ConflictTracker`), a `conflict_sample_rate` fraction of the
+  attempts report the conflicting key ranges to the tracker when they
+  fail with `not_committed` error.
+
+  If a `t:FDB.Tenant.t/0` is given, the transaction runs within the
+  tenant, with the defaults of the database the tenant was opened
+  from.
   """
-  @spec transact(t, (Transaction.t() -> any)) :: any
+  @spec transact(t | Tenant.t(), (Transaction.t() -> any)) :: any
   def transact(%__MODULE__{} = database, callback) when is_function(callback) do
-    do_transact(Transaction.create(database), callback)
+    do_transact(Transaction.create(database), callback, database)
   end
 
-  defp do_transact(%Transaction{} = transaction, callback) do
-    result = callback.(transaction)
-    :ok = Transaction.commit(transaction)
-    result
+  def transact(%Tenant{database: database} = tenant, callback) when is_function(callback) do
+    do_transact(Transaction.create(tenant), callback, database)
+  end
+
+  @not_committed 1020
+
+  defp do_transact(%Transaction{} = transaction, callback, database) do
+    report_conflicts = report_conflicts?(database)
+
+    try do
+      if report_conflicts do
+        :ok =
+          Transaction.set_option(
+            transaction,
+            Option.transaction_option_report_conflicting_keys()
+          )
+      end
+
+      result = callback.(transaction)
+      :ok = Transaction.commit(transaction)
+      result
+    rescue
+      e in FDB.Error ->
+        if report_conflicts && e.code == @not_committed do
+          record_conflicts(transaction, database.conflict_tracker)
+        end
+
+        :ok = Transaction.on_error(transaction, e.code)
+        do_transact(transaction, callback, database)
+    end
+  end
+
+  defp report_conflicts?(%__MODULE__{conflict_tracker: nil}), do: false
+  defp report_conflicts?(%__MODULE__{conflict_sample_rate: rate}) when rate >= 1.0, do: true
+  defp report_conflicts?(%__MODULE__{conflict_sample_rate: rate}), do: :rand.uniform() <= rate
+
+  # the conflict report is best effort, it must not change the
+  # outcome of the transaction
+  defp record_conflicts(transaction, tracker) do
+    ConflictTracker.record(tracker, Transaction.get_conflicting_keys(transaction))
   rescue
-    e in FDB.Error ->
-      :ok = Transaction.on_error(transaction, e.code)
-      do_transact(transaction, callback)
+    FDB.Error -> :ok
   end
 end
@@ -9,3 +9,9 @@ defmodule FDB.TimeoutError do
 
   @type t :: %__MODULE__{message: binary}
 end
+
+defmodule FDB.OverloadError do
+  defexception [:message]
+
+  @type t :: %__MODULE__{message: binary}
+end
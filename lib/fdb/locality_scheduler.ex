@@ -0,0 +1,163 @@
+defmodule FDB.LocalityScheduler do
+  @moduledoc """
+  Runs work over a large key range in parallel, while limiting the
+  number of tasks which hit each storage server at once.
+
+      shards = FDB.LocalityScheduler.shards(db, FDB.KeyRange.starts_with({"events"}))
+
+      FDB.LocalityScheduler.run(shards, fn range, _addresses ->
+        FDB.Database.get_range_stream(
+          db,
+          FDB.KeySelectorRange.range(
+            FDB.KeySelector.first_greater_or_equal(range.begin.key),
+            FDB.KeySelector.first_greater_or_equal(range.end.key)
+          ),
+          %{coder: FDB.Transaction.Coder.new()}
+        )
+        |> Enum.count()
+      end, %{concurrency: 16, per_server: 2})
+
+  `shards/3` splits the range with
+  `FDB.Transaction.get_range_split_points/4` and looks up the storage
+  servers of each part with `FDB.Transaction.get_addresses_for_key/2`
+  (the servers of its first key). `run/3` then starts a task for a
+  part only when each of its servers runs less than `per_server`
+  tasks, so the tasks are spread over the cluster instead of queueing
+  on the servers of a few shards. A part is counted against all its
+  replicas, as the writes go to all of them.
+
+  The ranges are raw keys, read them with an identity coder like
+  above.
+  """
+  alias FDB.{Database, Transaction, KeyRange, Future}
+
+  @raw Transaction.Coder.new()
+
+  @type shard :: {KeyRange.t(), [String.t()]}
+
+  @doc """
+  Splits the key range into parts of about `chunk_size` bytes and
+  returns them with the addresses of their storage servers.
+
+  ## Options
+
+  * `:coder` - (`t:FDB.Transaction.Coder.t/0`) used to encode the
+    range. Defaults to the coder of the database.
+  * `:chunk_size` - (integer) Defaults to `10_000_000`.
+  """
+  @spec shards(Database.t(), KeyRange.t(), map) :: [shard]
+  def shards(%Database{} = database, %KeyRange{} = key_range, options \\ %{}) do
+    coder = Map.get(options, :coder, database.coder)
+    chunk_size = Map.get(options, :chunk_size, 10_000_000)
+
+    Database.transact(database, fn t ->
+      ranges =
+        Transaction.get_range_split_points(t, key_range, chunk_size, %{coder: coder})
+        |> Enum.chunk_every(2, 1, :discard)
+        |> Enum.map(fn [begin_key, end_key] -> KeyRange.range(begin_key, end_key) end)
+
+      addresses =
+        Enum.map(ranges, &Transaction.get_addresses_for_key_q(t, &1.begin.key, %{coder: @raw}))
+        |> Future.all()
+        |> Future.await()
+
+      Enum.zip(ranges, Enum.map(addresses, &Enum.sort/1))
+    end)
+  end
+
+  @doc """
+  Calls `fun.(range, addresses)` for each shard and returns the
+  results in the order of the shards.
+
+  ## Options
+
+  * `:concurrency` - (integer) maximum number of tasks. Defaults to
+    `System.schedulers_online/0`.
+  * `:per_server` - (integer) maximum number of tasks per storage
+    server. Defaults to `1`.
+
+  The shards without addresses are counted against a single unknown
+  server, so they are limited by `per_server` too.
+  """
+  @spec run([shard], (KeyRange.t(), [String.t()] -> any), map) :: [any]
+  def run(shards, fun, options \\ %{}) when is_list(shards) and is_function(fun, 2) do
+    state = %{
+      fun: fun,
+      concurrency: positive_integer!(options, :concurrency, System.schedulers_online()),
+      per_server: positive_integer!(options, :per_server, 1),
+      pending: Enum.with_index(shards),
+      running: %{},
+      load: %{},
+      results: %{}
+    }
+
+    loop(state).results
+    |> Enum.sort()
+    |> Enum.map(fn {_index, result} -> result end)
+  end
+
+  defp loop(%{pending: [], running: running} = state) when map_size(running) == 0, do: state
+
+  defp loop(state) do
+    state = start(state)
+
+    receive do
+      {ref, {__MODULE__, index, result}} when is_reference(ref) ->
+        Process.demonitor(ref, [:flush])
+        {{_range, addresses}, running} = Map.pop(state.running, ref)
+
+        state = %{
+          state
+          | running: running,
+            load: add_load(state.load, addresses, -1),
+            results: Map.put(state.results, index, result)
+        }
+
+        loop(state)
+    end
+  end
+
+  # starts the first pending shards whose servers are below the limit
+  defp start(state) do
+    if map_size(state.running) >= state.concurrency do
+      state
+    else
+      case Enum.split_while(state.pending, &(!available?(state, &1))) do
+        {_, []} ->
+          state
+
+        {blocked, [{{range, addresses} = shard, index} | rest]} ->
+          fun = state.fun
+          task = Task.async(fn -> {__MODULE__, index, fun.(range, addresses)} end)
+
+          start(%{
+            state
+            | pending: blocked ++ rest,
+              running: Map.put(state.running, task.ref, shard),
+              load: add_load(state.load, addresses, 1)
+          })
+      end
+    end
+  end
+
+  defp available?(state, {{_range, addresses}, _index}) do
+    Enum.all?(servers(addresses), &(Map.get(state.load, &1, 0) < state.per_server))
+  end
+
+  defp add_load(load, addresses, n) do
+    Enum.reduce(servers(addresses), load, &Map.update(&2, &1, n, fn m -> m + n end))
+  end
+
+  defp servers([]), do: [:unknown]
+  defp servers(addresses), do: addresses
+
+  defp positive_integer!(options, key, default) do
+    case Map.get(options, key, default) do
+      value when is_integer(value) and value > 0 ->
+        value
+
+      value ->
+        raise ArgumentError, "Invalid #{key}: #{inspect(value)}, expected a positive integer"
+    end
+  end
+end
@@ -20,6 +20,7 @@ defmodule FDB.Native do
   def setup_network, do: :erlang.nif_error(:nif_library_not_loaded)
   def run_network, do: :erlang.nif_error(:nif_library_not_loaded)
   def stop_network, do: :erlang.nif_error(:nif_library_not_loaded)
+  def stats, do: :erlang.nif_error(:nif_library_not_loaded)
   def create_database(_file_path), do: :erlang.nif_error(:nif_library_not_loaded)
   def database_set_option(_database, _option), do: :erlang.nif_error(:nif_library_not_loaded)
 
@@ -27,6 +28,8 @@ defmodule FDB.Native do
     do: :erlang.nif_error(:nif_library_not_loaded)
 
   def database_create_transaction(_database), do: :erlang.nif_error(:nif_library_not_loaded)
+  def database_open_tenant(_database, _name), do: :erlang.nif_error(:nif_library_not_loaded)
+  def tenant_create_transaction(_tenant), do: :erlang.nif_error(:nif_library_not_loaded)
 
   def transaction_set_option(_transaction, _option),
     do: :erlang.nif_error(:nif_library_not_loaded)
@@ -71,6 +74,24 @@ defmodule FDB.Native do
       ),
       do: :erlang.nif_error(:nif_library_not_loaded)
 
+  def transaction_get_mapped_range(
+        _transaction,
+        _begin_key,
+        _begin_or_equal,
+        _begin_offset,
+        _end_key,
+        _end_or_equal,
+        _end_offset,
+        _mapper,
+        _limit,
+        _target_bytes,
+        _mode,
+        _iteration,
+        _snapshot,
+        _reverse
+      ),
+      do: :erlang.nif_error(:nif_library_not_loaded)
+
   def transaction_get_range_split_points(
         _transaction,
         _begin_key,
@@ -0,0 +1,310 @@
+defmodule FDB.Queue do
+  @moduledoc """
+  A durable work queue ordered by commit version.
+
+      queue = FDB.Queue.new("jobs", %{value_coder: FDB.Coder.ByteString.new()})
+
+      FDB.Database.transact(db, fn t ->
+        FDB.Queue.push(t, queue, "send welcome email")
+      end)
+
+      items = FDB.Queue.claim(db, queue, 10, %{timeout: 5000})
+      # process the items
+      :ok = FDB.Queue.ack(db, queue, Enum.map(items, & &1.id))
+
+  Items are stored under versionstamped keys, so producers never
+  conflict with each other or with the consumers. Each push also
+  increments a signal key with an atomic add, which idle consumers
+  watch instead of polling the queue.
+
+  A claim reads the first `n * spread` items with a snapshot read and
+  picks `n` of them at random, adding read conflicts only on the
+  picked items. Concurrent consumers rarely pick the same item, so a
+  larger `spread` trades strict ordering for fewer conflicts. The
+  claimed items are moved to an in-flight set with a lease, and must
+  be acked once processed. Acks can be passed to the next `claim/4`
+  call to save a transaction per batch, see `stream/3`. Items whose
+  lease expired are put back with `requeue_expired/3`.
+
+  The delivery is at least once.
+  """
+  alias FDB.{Database, Transaction, KeySelectorRange, Versionstamp, Future, Option}
+  alias FDB.Coder.{Subspace, Tuple, Integer, ByteString, Identity}
+
+  defstruct [:items, :values, :inflight, :signal, :lease, :spread]
+
+  @type t :: %__MODULE__{}
+
+  defmodule Item do
+    @moduledoc """
+    A claimed item. `id` is the versionstamp assigned when the item was
+    pushed.
+    """
+    defstruct [:id, :value]
+    @type t :: %__MODULE__{id: FDB.Versionstamp.t(), value: any}
+  end
+
+  @raw Transaction.Coder.new()
+  @one <<1::unsigned-little-integer-size(64)>>
+
+  @doc """
+  Creates a queue stored under the given prefix. The prefix can be a
+  raw binary or a directory.
+
+  ## Options
+
+  * `:value_coder` - (`t:FDB.Coder.t/0`) Defaults to `FDB.Coder.Identity.new()`.
+  * `:lease` - (integer) time in milliseconds after which a claimed but
+    not acked item can be requeued. Defaults to `30_000`.
+  * `:spread` - (integer) Defaults to `4`.
+  """
+  @spec new(binary | FDB.Directory.t(), map) :: t
+  def new(prefix, options \\ %{}) do
+    base = Subspace.new(prefix)
+    key = Tuple.new({Versionstamp.new()})
+    items = Subspace.concat(base, Subspace.new({{0}, Tuple.new({Integer.new()})}, key))
+    inflight = Subspace.concat(base, Subspace.new({{1}, Tuple.new({Integer.new()})}, key))
+    signal = Subspace.concat(base, Subspace.new({{2}, Tuple.new({Integer.new()})}))
+
+    %__MODULE__{
+      items: Transaction.Coder.new(items, Identity.new()),
+      values: Transaction.Coder.new(items, Map.get(options, :value_coder, Identity.new())),
+      inflight: Transaction.Coder.new(inflight, Tuple.new({Integer.new(), ByteString.new()})),
+      signal: signal.module.encode("", signal.opts),
+      lease: Map.get(options, :lease, 30_000),
+      spread: Map.get(options, :spread, 4)
+    }
+  end
+
+  @doc """
+  Pushes a value to the queue. The value becomes visible when the
+  transaction commits.
+
+  The ids of the items pushed in a transaction differ only in the
+  user version of the versionstamp, the items are ordered by the
+  order of the calls.
+  """
+  @spec push(Transaction.t(), t, any) :: :ok
+  def push(%Transaction{} = transaction, %__MODULE__{} = queue, value) do
+    push_all(transaction, queue, [value])
+  end
+
+  @doc """
+  Pushes the values to the queue in the given order. Refer `push/3`.
+  """
+  @spec push_all(Transaction.t(), t, [any]) :: :ok
+  def push_all(%Transaction{} = transaction, %__MODULE__{} = queue, values)
+      when is_list(values) do
+    first = Transaction.reserve_user_versions(transaction, length(values))
+
+    values
+    |> Enum.with_index(first)
+    |> Enum.each(fn {value, user_version} ->
+      :ok =
+        Transaction.set_versionstamped_key(
+          transaction,
+          {Versionstamp.incomplete(user_version)},
+          value,
+          %{coder: queue.values}
+        )
+    end)
+
+    signal(transaction, queue)
+  end
+
+  @doc """
+  Claims up to `n` items.
+
+  ## Options
+
+  * `:ack` - ([`t:FDB.Versionstamp.t/0`]) ids of the previously claimed
+    items which are acked in the same transaction.
+  * `:timeout` - (integer) if the queue is empty, waits up to
+    `timeout` milliseconds for new items. Defaults to `0`.
+  * `:lease` - (integer) overrides the lease of the queue.
+  """
+  @spec claim(Database.t(), t, pos_integer, map) :: [Item.t()]
+  def claim(%Database{} = database, %__MODULE__{} = queue, n, options \\ %{})
+      when is_integer(n) and n > 0 do
+    timeout = Map.get(options, :timeout, 0)
+    do_claim(database, queue, n, options, System.monotonic_time(:millisecond) + timeout)
+  end
+
+  defp do_claim(database, queue, n, options, deadline) do
+    lease = Map.get(options, :lease, queue.lease)
+    acks = Map.get(options, :ack, [])
+    wait = deadline > System.monotonic_time(:millisecond)
+
+    {items, watch} =
+      Database.transact(database, fn t ->
+        ack(t, queue, acks)
+        lease_until = System.os_time(:millisecond) + lease
+        items = claim_items(t, queue, n, lease_until)
+
+        if items == [] && wait do
+          {items, Transaction.watch_q(t, queue.signal, %{coder: @raw})}
+        else
+          {items, nil}
+        end
+      end)
+
+    if watch do
+      remaining = deadline - System.monotonic_time(:millisecond)
+
+      case await_watch(watch, max(remaining, 0)) do
+        :ok -> do_claim(database, queue, n, Map.delete(options, :ack), deadline)
+        :timeout -> []
+      end
+    else
+      Enum.map(items, fn {id, value} ->
+        %Item{id: id, value: Transaction.Coder.decode_value(queue.values, value)}
+      end)
+    end
+  end
+
+  defp claim_items(transaction, queue, n, lease_until) do
+    candidates =
+      Transaction.get_range(transaction, KeySelectorRange.starts_with(nil), %{
+        coder: queue.items,
+        snapshot: true,
+        limit: n * queue.spread,
+        mode: Option.streaming_mode_want_all()
+      }).key_values
+
+    candidates
+    |> Enum.take_random(n)
+    |> Enum.sort()
+    |> Enum.map(fn {{id} = key, value} ->
+      :ok =
+        Transaction.add_conflict_key(
+          transaction,
+          key,
+          Option.conflict_range_type_read(),
+          %{coder: queue.items}
+        )
+
+      :ok = Transaction.clear(transaction, key, %{coder: queue.items})
+      :ok = Transaction.set(transaction, key, {lease_until, value}, %{coder: queue.inflight})
+      {id, value}
+    end)
+  end
+
+  defp await_watch(watch, timeout) do
+    Future.await(watch, timeout)
+    :ok
+  rescue
+    FDB.TimeoutError -> :timeout
+  end
+
+  @doc """
+  Removes the claimed items from the queue.
+  """
+  @spec ack(Database.t() | Transaction.t(), t, [Versionstamp.t()]) :: :ok
+  def ack(%Database{} = database, %__MODULE__{} = queue, ids) do
+    Database.transact(database, fn t -> ack(t, queue, ids) end)
+  end
+
+  def ack(%Transaction{} = transaction, %__MODULE__{} = queue, ids) do
+    Enum.each(ids, fn id ->
+      :ok = Transaction.clear(transaction, {id}, %{coder: queue.inflight})
+    end)
+  end
+
+  @doc """
+  Returns a stream of the items in the queue. Items are claimed in
+  batches and the items of a batch are acked along with the claim of
+  the next batch. The items of the last batch are not acked when the
+  stream is halted, they can be acked with `ack/3` or are requeued
+  once their lease expires.
+
+  Note that the stream never ends.
+
+  ## Options
+
+  * `:batch_size` - (integer) Defaults to `100`.
+  * `:timeout` - (integer) time in milliseconds to wait for items on
+    each claim, before checking again. Defaults to `5000`.
+  """
+  @spec stream(Database.t(), t, map) :: Enumerable.t()
+  def stream(%Database{} = database, %__MODULE__{} = queue, options \\ %{}) do
+    batch_size = Map.get(options, :batch_size, 100)
+    claim_options = %{timeout: Map.get(options, :timeout, 5000)}
+
+    Stream.resource(
+      fn -> [] end,
+      fn acks ->
+        items = claim(database, queue, batch_size, Map.put(claim_options, :ack, acks))
+        {items, Enum.map(items, & &1.id)}
+      end,
+      fn _acks -> :ok end
+    )
+  end
+
+  @doc """
+  Puts back at most `limit` claimed items whose lease has expired. The
+  items keep their original position in the queue. Returns the number
+  of items requeued.
+  """
+  @spec requeue_expired(Database.t(), t, pos_integer) :: non_neg_integer
+  def requeue_expired(%Database{} = database, %__MODULE__{} = queue, limit \\ 1000) do
+    Database.transact(database, fn t ->
+      now = System.os_time(:millisecond)
+
+      expired =
+        Transaction.get_range_stream(t, KeySelectorRange.starts_with(nil), %{
+          coder: queue.inflight,
+          snapshot: true
+        })
+        |> Stream.filter(fn {_key, {lease_until, _value}} -> lease_until < now end)
+        |> Enum.take(limit)
+
+      # conflicts only with an ack or another requeue of the same items
+      Enum.each(expired, fn {key, {_lease_until, value}} ->
+        :ok =
+          Transaction.add_conflict_key(
+            t,
+            key,
+            Option.conflict_range_type_read(),
+            %{coder: queue.inflight}
+          )
+
+        :ok = Transaction.clear(t, key, %{coder: queue.inflight})
+        :ok = Transaction.set(t, key, value, %{coder: queue.items})
+      end)
+
+      if expired != [] do
+        signal(t, queue)
+      end
+
+      length(expired)
+    end)
+  end
+
+  @doc """
+  Returns the number of items waiting to be claimed. This reads all
+  the keys of the queue and is meant for monitoring small queues and
+  tests.
+  """
+  @spec size(Database.t() | Transaction.t(), t) :: non_neg_integer
+  def size(%Database{} = database, %__MODULE__{} = queue) do
+    Database.transact(database, fn t -> size(t, queue) end)
+  end
+
+  def size(%Transaction{} = transaction, %__MODULE__{} = queue) do
+    Transaction.get_range_stream(transaction, KeySelectorRange.starts_with(nil), %{
+      coder: queue.items,
+      snapshot: true
+    })
+    |> Enum.count()
+  end
+
+  defp signal(transaction, queue) do
+    Transaction.atomic_op(
+      transaction,
+      queue.signal,
+      Option.mutation_type_add(),
+      @one,
+      %{coder: @raw}
+    )
+  end
+end
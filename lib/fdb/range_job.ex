@@ -0,0 +1,226 @@
+defmodule FDB.RangeJob do
+  @moduledoc """
+  Runs a function over every key-value pair of a large key range, in
+  parallel and in many small transactions. Useful for migrations like
+  re-encoding the values or moving a subspace.
+
+      reencode = fn t, key, value ->
+        FDB.Transaction.set(t, key, upgrade(value), %{coder: new_coder})
+      end
+
+      :ok = FDB.RangeJob.run(db, "reencode-users", FDB.KeyRange.starts_with({"users"}), reencode)
+
+  On the first run the range is split into chunks of roughly
+  `chunk_size` bytes with `FDB.Transaction.get_range_split_points/4`
+  and a cursor per chunk is stored in the database under the
+  `:progress` prefix. The chunks are processed by `concurrency`
+  workers. Each transaction of a worker reads the pairs after the
+  cursor, calls the function for each of them and moves the cursor
+  forward, so the progress is committed along with the writes. A
+  transaction stops once the size of its writes reaches
+  `transaction_bytes` or it has run for `transaction_time`. If the job
+  crashes, calling `run/5` again with the same id resumes it from the
+  cursors.
+
+  The transactions run with batch priority. Each worker measures the
+  time taken to get a read version, which grows when the cluster is
+  loaded, and pauses between the transactions when it's above
+  `target_latency`, doubling the pause while the latency stays high.
+
+  The function could be called more than once for the same pair when
+  a transaction is retried, and should not have side effects outside
+  of the transaction.
+
+  ## Options
+
+  * `:coder` - (`t:FDB.Transaction.Coder.t/0`) coder of the range and
+    of the pairs passed to the function. Defaults to the coder of the
+    database.
+  * `:progress` - prefix (raw binary or directory) under which the
+    cursors are stored. Defaults to `"fdb_range_job"`.
+  * `:chunk_size` - (integer) Defaults to `10_000_000`.
+  * `:concurrency` - (integer) Defaults to `System.schedulers_online/0`.
+  * `:transaction_bytes` - (integer) Defaults to `1_000_000`.
+  * `:transaction_time` - (integer) milliseconds. Defaults to `1000`.
+  * `:target_latency` - (integer) milliseconds. Defaults to `50`.
+  * `:max_delay` - (integer) longest pause in milliseconds. Defaults
+    to `5000`.
+  """
+  alias FDB.{Database, Transaction, KeyRange, KeySelector, KeySelectorRange, Option}
+  alias FDB.Coder.{Subspace, Tuple, ByteString, Integer}
+
+  @raw Transaction.Coder.new()
+
+  @doc """
+  Runs the job till all the chunks are processed.
+  """
+  @spec run(Database.t(), binary, KeyRange.t(), (Transaction.t(), any, any -> any), map) :: :ok
+  def run(%Database{} = database, id, %KeyRange{} = key_range, transform, options \\ %{})
+      when is_binary(id) and is_function(transform, 3) do
+    job = %{
+      id: id,
+      transform: transform,
+      coder: Map.get(options, :coder, database.coder),
+      progress: progress_coder(options),
+      transaction_bytes: Map.get(options, :transaction_bytes, 1_000_000),
+      transaction_time: Map.get(options, :transaction_time, 1000),
+      target_latency: Map.get(options, :target_latency, 50),
+      max_delay: Map.get(options, :max_delay, 5000)
+    }
+
+    chunks = chunks(database, job, key_range, Map.get(options, :chunk_size, 10_000_000))
+
+    chunks
+    |> Enum.reject(fn {_index, {_cursor, _end_key, done, _count}} -> done == 1 end)
+    |> Task.async_stream(fn {index, _} -> process(database, job, index, 0) end,
+      max_concurrency: Map.get(options, :concurrency, System.schedulers_online()),
+      ordered: false,
+      timeout: :infinity
+    )
+    |> Stream.run()
+  end
+
+  @doc """
+  Returns the number of `chunks`, the number of chunks `done` and the
+  number of pairs `processed` so far, or `nil` if the job was never
+  started.
+  """
+  @spec status(Database.t(), binary, map) :: map | nil
+  def status(%Database{} = database, id, options \\ %{}) do
+    job = %{id: id, progress: progress_coder(options)}
+
+    case Database.transact(database, &read_chunks(&1, job)) do
+      [] ->
+        nil
+
+      chunks ->
+        Enum.reduce(chunks, %{chunks: 0, done: 0, processed: 0}, fn {_, {_, _, done, count}},
+                                                                   acc ->
+          %{chunks: acc.chunks + 1, done: acc.done + done, processed: acc.processed + count}
+        end)
+    end
+  end
+
+  @doc """
+  Removes the stored progress of the job, the next `run/5` starts
+  from the beginning.
+  """
+  @spec reset(Database.t(), binary, map) :: :ok
+  def reset(%Database{} = database, id, options \\ %{}) do
+    coder = progress_coder(options)
+
+    Database.transact(database, fn t ->
+      Transaction.clear_range(t, KeyRange.starts_with({id}), %{coder: coder})
+    end)
+  end
+
+  defp progress_coder(options) do
+    Transaction.Coder.new(
+      Subspace.new(
+        Map.get(options, :progress, "fdb_range_job"),
+        Tuple.new({ByteString.new(), Integer.new()})
+      ),
+      Tuple.new({ByteString.new(), ByteString.new(), Integer.new(), Integer.new()})
+    )
+  end
+
+  defp read_chunks(transaction, job) do
+    Transaction.get_range_stream(transaction, KeySelectorRange.starts_with({job.id}), %{
+      coder: job.progress
+    })
+    |> Enum.map(fn {{_id, index}, chunk} -> {index, chunk} end)
+  end
+
+  defp chunks(database, job, key_range, chunk_size) do
+    Database.transact(database, fn t ->
+      case read_chunks(t, job) do
+        [] ->
+          Transaction.get_range_split_points(t, key_range, chunk_size, %{coder: job.coder})
+          |> Enum.chunk_every(2, 1, :discard)
+          |> Enum.with_index()
+          |> Enum.map(fn {[begin_key, end_key], index} ->
+            chunk = {begin_key, end_key, 0, 0}
+            :ok = Transaction.set(t, {job.id, index}, chunk, %{coder: job.progress})
+            {index, chunk}
+          end)
+
+        chunks ->
+          chunks
+      end
+    end)
+  end
+
+  defp process(database, job, index, delay) do
+    if delay > 0 do
+      Process.sleep(delay)
+    end
+
+    {done, latency} = Database.transact(database, &process_batch(&1, job, index))
+
+    unless done do
+      delay =
+        if latency > job.target_latency do
+          min(job.max_delay, max(delay * 2, 10))
+        else
+          div(delay, 2)
+        end
+
+      process(database, job, index, delay)
+    end
+  end
+
+  defp process_batch(transaction, job, index) do
+    :ok = Transaction.set_option(transaction, Option.transaction_option_priority_batch())
+    started = System.monotonic_time(:millisecond)
+    Transaction.get_read_version(transaction)
+    latency = System.monotonic_time(:millisecond) - started
+
+    case Transaction.get(transaction, {job.id, index}, %{coder: job.progress}) do
+      nil ->
+        {true, latency}
+
+      {_cursor, _end_key, 1, _count} ->
+        {true, latency}
+
+      {cursor, end_key, 0, count} ->
+        range =
+          KeySelectorRange.range(
+            KeySelector.first_greater_or_equal(cursor),
+            KeySelector.first_greater_or_equal(end_key)
+          )
+
+        {last_key, processed, stopped} =
+          Transaction.get_range_stream(transaction, range, %{coder: @raw})
+          |> Enum.reduce_while({nil, 0, false}, fn {key, value}, {_, processed, _} ->
+            job.transform.(
+              transaction,
+              Transaction.Coder.decode_key(job.coder, key),
+              Transaction.Coder.decode_value(job.coder, value)
+            )
+
+            processed = processed + 1
+
+            if rem(processed, 10) == 0 && full?(transaction, job, started) do
+              {:halt, {key, processed, true}}
+            else
+              {:cont, {key, processed, false}}
+            end
+          end)
+
+        chunk =
+          if stopped do
+            {last_key <> <<0x00>>, end_key, 0, count + processed}
+          else
+            {end_key, end_key, 1, count + processed}
+          end
+
+        :ok = Transaction.set(transaction, {job.id, index}, chunk, %{coder: job.progress})
+        {!stopped, latency}
+    end
+  end
+
+  defp full?(transaction, job, started) do
+    System.monotonic_time(:millisecond) - started >= job.transaction_time ||
+      Transaction.get_approximate_size(transaction) >= job.transaction_bytes
+  end
+end
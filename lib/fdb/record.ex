@@ -0,0 +1,262 @@
+defmodule FDB.Record do
+  @moduledoc """
+  A record type with secondary indexes.
+
+      users =
+        FDB.Record.new("users", %{
+          primary_key: Coder.Integer.new(),
+          value_coder: Coder.Tuple.new({Coder.UnicodeString.new(), Coder.Integer.new()}),
+          indexes: %{
+            name: %{key: 0, coder: Coder.UnicodeString.new()},
+            age: %{key: fn {_name, age} -> age end, coder: Coder.Integer.new()}
+          }
+        })
+
+      FDB.Database.transact(db, fn t ->
+        FDB.Record.put(t, users, 1, {"alice", 30})
+        FDB.Record.put(t, users, 2, {"bob", 25})
+      end)
+
+      FDB.Database.transact(db, fn t ->
+        FDB.Record.query(t, users, :name, "alice")
+        # [{1, {"alice", 30}}]
+        FDB.Record.query_range(t, users, :age, 20, 30)
+        # [{2, {"bob", 25}}]
+      end)
+
+  Every write of a record updates the index entries in the same
+  transaction, so the indexes are always consistent with the
+  records. The index entries are stored as `{index_value,
+  primary_key}` keys, a query reads the matching entries with a range
+  read and fetches the records in parallel, so the cost is
+  proportional to the size of the result instead of the number of
+  records.
+
+  ## Index options
+
+  * `:key` - how the index value is extracted from the record. Either
+    a function of the record, an atom (map key) or an integer (tuple
+    element). Records for which the index value is `nil` are not
+    indexed.
+  * `:coder` - (`t:FDB.Coder.t/0`) the coder of the index value.
+  """
+  alias FDB.{Database, Transaction, KeySelector, KeySelectorRange, Future, Option, RangeResult}
+  alias FDB.Coder.{Subspace, Tuple, Integer, UnicodeString, Identity}
+
+  defstruct [:records, :indexes]
+
+  @type t :: %__MODULE__{}
+
+  @doc """
+  Creates a record type stored under the given prefix. The prefix can
+  be a raw binary or a directory.
+
+  ## Options
+
+  * `:primary_key` - (`t:FDB.Coder.t/0`) required.
+  * `:value_coder` - (`t:FDB.Coder.t/0`) Defaults to `FDB.Coder.Identity.new()`.
+  * `:indexes` - (map) index name to index options. Defaults to `%{}`.
+  """
+  @spec new(binary | FDB.Directory.t(), map) :: t
+  def new(prefix, options) do
+    base = Subspace.new(prefix)
+    primary_key = Map.fetch!(options, :primary_key)
+
+    records =
+      Transaction.Coder.new(
+        Subspace.concat(base, Subspace.new({{0}, Tuple.new({Integer.new()})}, primary_key)),
+        Map.get(options, :value_coder, Identity.new())
+      )
+
+    indexes =
+      Map.get(options, :indexes, %{})
+      |> Map.new(fn {name, index} ->
+        subspace =
+          Subspace.new(
+            {{1, to_string(name)}, Tuple.new({Integer.new(), UnicodeString.new()})},
+            Tuple.new({Map.fetch!(index, :coder), primary_key})
+          )
+
+        coder = Transaction.Coder.new(Subspace.concat(base, subspace), Identity.new())
+        {name, %{coder: coder, key: Map.fetch!(index, :key)}}
+      end)
+
+    %__MODULE__{records: records, indexes: indexes}
+  end
+
+  @doc """
+  Returns the record with the given primary key or `nil`.
+  """
+  @spec get(Transaction.t(), t, any, map) :: any
+  def get(%Transaction{} = transaction, %__MODULE__{} = record, primary_key, options \\ %{}) do
+    get_q(transaction, record, primary_key, options)
+    |> Future.await()
+  end
+
+  @doc """
+  Async version of `get/4`
+  """
+  @spec get_q(Transaction.t(), t, any, map) :: Future.t()
+  def get_q(%Transaction{} = transaction, %__MODULE__{} = record, primary_key, options \\ %{}) do
+    Transaction.get_q(transaction, primary_key, Map.put(options, :coder, record.records))
+  end
+
+  @doc """
+  Inserts or replaces the record and updates the indexes.
+  """
+  @spec put(Transaction.t(), t, any, any) :: :ok
+  def put(%Transaction{} = transaction, %__MODULE__{} = record, primary_key, value) do
+    old = get(transaction, record, primary_key)
+    :ok = update_indexes(transaction, record, primary_key, old, value)
+    Transaction.set(transaction, primary_key, value, %{coder: record.records})
+  end
+
+  @doc """
+  Deletes the record and its index entries.
+  """
+  @spec delete(Transaction.t(), t, any) :: :ok
+  def delete(%Transaction{} = transaction, %__MODULE__{} = record, primary_key) do
+    case get(transaction, record, primary_key) do
+      nil ->
+        :ok
+
+      old ->
+        :ok = update_indexes(transaction, record, primary_key, old, nil)
+        Transaction.clear(transaction, primary_key, %{coder: record.records})
+    end
+  end
+
+  defp update_indexes(transaction, record, primary_key, old, new) do
+    Enum.each(record.indexes, fn {_name, index} ->
+      old_value = index_value(index, old)
+      new_value = index_value(index, new)
+
+      if old_value != new_value do
+        if old_value != nil do
+          :ok = Transaction.clear(transaction, {old_value, primary_key}, %{coder: index.coder})
+        end
+
+        if new_value != nil do
+          :ok = Transaction.set(transaction, {new_value, primary_key}, "", %{coder: index.coder})
+        end
+      end
+    end)
+  end
+
+  defp index_value(_index, nil), do: nil
+  defp index_value(%{key: key}, value) when is_function(key, 1), do: key.(value)
+  defp index_value(%{key: key}, value) when is_atom(key), do: Map.get(value, key)
+  defp index_value(%{key: key}, value) when is_integer(key), do: elem(value, key)
+
+  @doc """
+  Returns the `{primary_key, record}` pairs whose index value is equal
+  to `value`, ordered by primary key.
+
+  ## Options
+
+  * `:limit` - (integer) maximum number of records. Defaults to `0` (no limit).
+  * `:snapshot` - (boolean) Defaults to `false`.
+  """
+  @spec query(Transaction.t(), t, atom, any, map) :: [{any, any}]
+  def query(%Transaction{} = transaction, %__MODULE__{} = record, name, value, options \\ %{}) do
+    index = fetch_index!(record, name)
+    fetch(transaction, record, index, KeySelectorRange.starts_with({value}), options)
+  end
+
+  @doc """
+  Returns the `{primary_key, record}` pairs whose index value is
+  greater than or equal to `begin_value` and less than `end_value`,
+  ordered by index value. Refer `query/5` for options.
+  """
+  @spec query_range(Transaction.t(), t, atom, any, any, map) :: [{any, any}]
+  def query_range(
+        %Transaction{} = transaction,
+        %__MODULE__{} = record,
+        name,
+        begin_value,
+        end_value,
+        options \\ %{}
+      ) do
+    index = fetch_index!(record, name)
+
+    range =
+      KeySelectorRange.range(
+        KeySelector.first_greater_or_equal({begin_value}, %{prefix: :first}),
+        KeySelector.first_greater_or_equal({end_value}, %{prefix: :first})
+      )
+
+    fetch(transaction, record, index, range, options)
+  end
+
+  defp fetch(transaction, record, index, range, options) do
+    primary_keys =
+      Transaction.get_range_stream(
+        transaction,
+        range,
+        Map.merge(Map.take(options, [:limit, :snapshot]), %{coder: index.coder})
+      )
+      |> Enum.map(fn {{_value, primary_key}, _} -> primary_key end)
+
+    primary_keys
+    |> Enum.map(&get_q(transaction, record, &1, Map.take(options, [:snapshot])))
+    |> Future.all()
+    |> Future.await()
+    |> Enum.zip(primary_keys)
+    |> Enum.map(fn {value, primary_key} -> {primary_key, value} end)
+  end
+
+  defp fetch_index!(record, name) do
+    case Map.fetch(record.indexes, name) do
+      {:ok, index} -> index
+      :error -> raise ArgumentError, "Unknown index: #{inspect(name)}"
+    end
+  end
+
+  @doc """
+  Builds the entries of an index for the records written before the
+  index was defined. The records are processed in batches of
+  `batch_size`, each batch is read and indexed in the same
+  transaction, so a concurrent write of a record in the batch makes
+  the batch retry instead of leaving a stale entry.
+  """
+  @spec build_index(Database.t(), t, atom, pos_integer) :: :ok
+  def build_index(%Database{} = database, %__MODULE__{} = record, name, batch_size \\ 100) do
+    index = fetch_index!(record, name)
+    build_index_batch(database, record, index, KeySelectorRange.starts_with(nil), batch_size)
+  end
+
+  defp build_index_batch(database, record, index, range, batch_size) do
+    last_key =
+      Database.transact(database, fn t ->
+        %RangeResult{key_values: key_values, has_more: has_more} =
+          Transaction.get_range(t, range, %{
+            coder: record.records,
+            limit: batch_size,
+            mode: Option.streaming_mode_want_all()
+          })
+
+        Enum.each(key_values, fn {primary_key, value} ->
+          case index_value(index, value) do
+            nil ->
+              :ok
+
+            index_value ->
+              Transaction.set(t, {index_value, primary_key}, "", %{coder: index.coder})
+          end
+        end)
+
+        if has_more || length(key_values) == batch_size do
+          elem(List.last(key_values), 0)
+        end
+      end)
+
+    case last_key do
+      nil ->
+        :ok
+
+      last_key ->
+        range = KeySelectorRange.range(KeySelector.first_greater_than(last_key), range.end)
+        build_index_batch(database, record, index, range, batch_size)
+    end
+  end
+end
@@ -0,0 +1,180 @@
+defmodule FDB.Router do
+  @moduledoc """
+  Spreads the keys across several databases (clusters), either by key
+  range or by hash.
+
+      router =
+        FDB.Router.ranges([
+          {"", FDB.Database.create("/etc/foundationdb/a.cluster")},
+          {"m", FDB.Database.create("/etc/foundationdb/b.cluster")}
+        ])
+
+      FDB.Router.transact(router, "user:42", fn t ->
+        FDB.Transaction.set(t, "user:42", "alice")
+      end)
+
+      FDB.Router.get_range_stream(router, FDB.KeySelectorRange.starts_with("user:"))
+      |> Enum.to_list()
+
+  A transaction runs on the database which owns the given key, so all
+  the keys read or written in a transaction should belong to the same
+  database. There are no transactions across databases.
+
+  `get_range_stream/3` reads from every database that owns a part of
+  the range. With range partitioning the databases are read one after
+  the other in key order. With hash partitioning all of them are read
+  together and the streams are merged in key order.
+
+  The databases are routed to using the raw key, encoded with the
+  `:coder` option, which is also used to merge the streams in key
+  order. The keys are stored using the coder of each database, which
+  is usually the same.
+  """
+  alias FDB.{Database, KeySelectorRange, Transaction}
+  alias FDB.Transaction.Coder
+
+  defstruct [:coder, :partition, :shards]
+
+  @type t :: %__MODULE__{}
+
+  @doc """
+  Creates a router with range partitioning. `shards` is a list of
+  `{begin_key, database}`, the database owns the raw keys from its
+  `begin_key` till the `begin_key` of the next one. The first
+  `begin_key` must be `""`.
+
+  ## Options
+
+  * `:coder` - (`t:FDB.Transaction.Coder.t/0`) used to encode the keys
+    before routing. Defaults to the coder of the first database.
+  """
+  @spec ranges([{binary, Database.t()}], map) :: t
+  def ranges([{"", %Database{} = first} | _] = shards, options \\ %{}) do
+    shards = Enum.sort_by(shards, fn {begin_key, _} -> begin_key end)
+    %__MODULE__{coder: Map.get(options, :coder, first.coder), partition: :range, shards: shards}
+  end
+
+  @doc """
+  Creates a router with hash partitioning.
+
+  ## Options
+
+  * `:coder` - (`t:FDB.Transaction.Coder.t/0`) used to encode the keys
+    before routing. Defaults to the coder of the first database.
+  * `:partition_key` - function of the key which returns the term that
+    is hashed. Keys with the same partition key are stored in the same
+    database. Defaults to the raw key.
+  """
+  @spec hash([Database.t()], map) :: t
+  def hash([%Database{} = first | _] = databases, options \\ %{}) do
+    %__MODULE__{
+      coder: Map.get(options, :coder, first.coder),
+      partition: {:hash, Map.get(options, :partition_key)},
+      shards: List.to_tuple(databases)
+    }
+  end
+
+  @doc """
+  Returns the database which owns the key.
+  """
+  @spec database(t, any) :: Database.t()
+  def database(%__MODULE__{partition: :range} = router, key) do
+    raw = Coder.encode_key(router.coder, key)
+
+    {_, database} =
+      router.shards
+      |> Enum.take_while(fn {begin_key, _} -> begin_key <= raw end)
+      |> List.last()
+
+    database
+  end
+
+  def database(%__MODULE__{partition: {:hash, partition_key}} = router, key) do
+    term = if partition_key, do: partition_key.(key), else: Coder.encode_key(router.coder, key)
+    elem(router.shards, :erlang.phash2(term, tuple_size(router.shards)))
+  end
+
+  @doc """
+  Runs the transaction on the database which owns the key. Refer
+  `FDB.Database.transact/2`.
+  """
+  @spec transact(t, any, (Transaction.t() -> any)) :: any
+  def transact(%__MODULE__{} = router, key, callback) when is_function(callback) do
+    Database.transact(database(router, key), callback)
+  end
+
+  @doc """
+  Refer `FDB.Database.get_range_stream/3`. The key selector offsets
+  are resolved within each database.
+  """
+  @spec get_range_stream(t, KeySelectorRange.t(), map) :: Enumerable.t()
+  def get_range_stream(%__MODULE__{} = router, %KeySelectorRange{} = range, options \\ %{}) do
+    reverse = Map.get(options, :reverse, false) in [true, 1]
+
+    stream =
+      case router.partition do
+        :range ->
+          databases = databases(router, range)
+          databases = if reverse, do: Enum.reverse(databases), else: databases
+          Stream.flat_map(databases, &Database.get_range_stream(&1, range, options))
+
+        {:hash, _} ->
+          router.shards
+          |> Tuple.to_list()
+          |> Enum.map(fn database ->
+            Database.get_range_stream(database, range, options)
+            |> Stream.map(fn {key, _value} = item ->
+              {Coder.encode_key(router.coder, key), item}
+            end)
+          end)
+          |> merge(reverse)
+      end
+
+    case Map.get(options, :limit, 0) do
+      0 -> stream
+      limit -> Stream.take(stream, limit)
+    end
+  end
+
+  @doc false
+  # Returns the databases which own a part of the range, in key order.
+  def databases(router, range) do
+    begin_key = Coder.encode_range(router.coder, range.begin.key, range.begin.prefix)
+    end_key = Coder.encode_range(router.coder, range.end.key, range.end.prefix)
+    ends = Enum.map(Enum.drop(router.shards, 1), fn {begin_key, _} -> begin_key end)
+
+    # the end key itself is in the range only if the end selector can
+    # resolve past it, like first_greater_than
+    inclusive_end = range.end.offset > 1 || (range.end.offset == 1 && range.end.or_equal == 1)
+
+    Enum.zip(router.shards, ends ++ [nil])
+    |> Enum.filter(fn {{shard_begin, _}, shard_end} ->
+      (shard_begin < end_key || (inclusive_end && shard_begin == end_key)) &&
+        (shard_end == nil || shard_end > begin_key)
+    end)
+    |> Enum.map(fn {{_, database}, _} -> database end)
+  end
+
+  defp merge(streams, reverse) do
+    Stream.resource(
+      fn -> Enum.flat_map(streams, &step(Enumerable.reduce(&1, {:cont, nil}, &suspend/2))) end,
+      fn
+        [] ->
+          {:halt, []}
+
+        heads ->
+          {{_key, item}, continuation} = head = next(heads, reverse)
+          {[item], step(continuation.({:cont, nil})) ++ List.delete(heads, head)}
+      end,
+      fn heads -> Enum.each(heads, fn {_, continuation} -> continuation.({:halt, nil}) end) end
+    )
+  end
+
+  defp next(heads, false), do: Enum.min_by(heads, fn {{key, _}, _} -> key end)
+  defp next(heads, true), do: Enum.max_by(heads, fn {{key, _}, _} -> key end)
+
+  defp suspend(item, _acc), do: {:suspend, item}
+
+  defp step({:suspended, item, continuation}), do: [{item, continuation}]
+  defp step({_done_or_halted, _acc}), do: []
+end
@@ -0,0 +1,323 @@
+defmodule FDB.Scheduler do
+  @moduledoc """
+  Admission control for transactions, with a concurrency limit per
+  priority class.
+
+      {:ok, scheduler} =
+        FDB.Scheduler.start_link(
+          name: MyApp.Scheduler,
+          classes: %{
+            interactive: %{priority: :default, max_concurrency: 200},
+            batch: %{priority: :batch, tags: ["reindex"], max_concurrency: 20}
+          }
+        )
+
+      FDB.Scheduler.transact(MyApp.Scheduler, db, :batch, fn t ->
+        FDB.Transaction.get(t, key)
+      end)
+
+  `transact/4` waits in the queue of the class till the number of
+  running transactions of the class is below its limit and then runs
+  the transaction like `FDB.Database.transact/2`. Each attempt is
+  started with the priority and the throttling tags of the class.
+
+  The limit of a class adapts to the load of the cluster, it's
+  increased by one for every `limit` transactions which committed
+  within `target_latency` and decreased by a quarter when the commit
+  took longer or when an attempt failed with
+  `proxy_memory_limit_exceeded`, `batch_transaction_throttled` or
+  `tag_throttled` error. The limit is decreased at most once per
+  `decrease_interval`, as the transactions which were running when the
+  cluster got overloaded all report it. So under overload the batch
+  class, which the cluster throttles first, backs off and leaves room
+  for the others.
+
+  When the queue of a class is full, `transact/4` raises
+  `FDB.OverloadError` without running the transaction.
+
+  If the application depends on
+  [telemetry](https://hex.pm/packages/telemetry), the following events
+  are emitted with metadata `class`
+
+  * `[:fdb, :scheduler, :admit]` - when a transaction is admitted,
+    with measurements `wait` (time in native units spent in the queue)
+    and `queued` (queue length).
+  * `[:fdb, :scheduler, :stop]` - when a transaction is done, with
+    measurements `duration` (native units), `attempts` and `limit`.
+
+  ## Options
+
+  * `:name` - registers the scheduler under the given name.
+  * `:classes` - (map) class name to class options. Defaults to a
+    single class `:default`.
+  * `:target_latency` - (integer) commit latency in milliseconds above
+    which the limit is decreased. Defaults to `100`.
+  * `:decrease_interval` - (integer) minimum time in milliseconds
+    between two decreases of the limit of a class. Defaults to
+    `:target_latency`.
+
+  ## Class options
+
+  * `:priority` - `:batch`, `:default` or `:immediate`, refer
+    `FDB.Option.transaction_option_priority_batch/0` and
+    `FDB.Option.transaction_option_priority_system_immediate/0`.
+    Defaults to `:default`.
+  * `:tags` - (list) throttling tags, refer
+    `FDB.Option.transaction_option_tag/0`. Defaults to `[]`.
+  * `:min_concurrency` - (integer) Defaults to `1`.
+  * `:max_concurrency` - (integer) Defaults to `100`.
+  * `:max_queue` - (integer) Defaults to `10_000`.
+  """
+  use GenServer
+  alias FDB.{Database, Transaction, Option, Telemetry}
+
+  @throttled [1042, 1051, 1078, 1213]
+
+  @spec start_link(keyword) :: GenServer.on_start()
+  def start_link(opts \\ []) do
+    {name, opts} = Keyword.pop(opts, :name)
+
+    if name do
+      GenServer.start_link(__MODULE__, opts, name: name)
+    else
+      GenServer.start_link(__MODULE__, opts)
+    end
+  end
+
+  @doc """
+  Runs the transaction in the given class once admitted. Refer
+  `FDB.Database.transact/2`.
+  """
+  @spec transact(GenServer.server(), Database.t(), atom, (Transaction.t() -> any)) :: any
+  def transact(scheduler, %Database{} = database, class, callback) when is_function(callback) do
+    case GenServer.call(scheduler, {:acquire, class}, :infinity) do
+      {:ok, ref, options} ->
+        started = System.monotonic_time()
+
+        try do
+          {result, feedback} =
+            run(Transaction.create(database), callback, options, %{
+              attempts: 1,
+              throttled: false,
+              latency: 0
+            })
+
+          feedback = Map.put(feedback, :duration, System.monotonic_time() - started)
+          GenServer.cast(scheduler, {:release, ref, feedback})
+          result
+        catch
+          kind, reason ->
+            GenServer.cast(scheduler, {:release, ref, nil})
+            :erlang.raise(kind, reason, __STACKTRACE__)
+        end
+
+      {:error, :overloaded} ->
+        raise FDB.OverloadError, message: "Queue of class #{inspect(class)} is full"
+
+      {:error, :unknown_class} ->
+        raise ArgumentError, "Unknown class: #{inspect(class)}"
+    end
+  end
+
+  defp run(transaction, callback, options, feedback) do
+    try do
+      Enum.each(options, fn
+        {option, value} -> :ok = Transaction.set_option(transaction, option, value)
+        option -> :ok = Transaction.set_option(transaction, option)
+      end)
+
+      result = callback.(transaction)
+      started = System.monotonic_time()
+      :ok = Transaction.commit(transaction)
+      {result, %{feedback | latency: System.monotonic_time() - started}}
+    rescue
+      e in FDB.Error ->
+        :ok = Transaction.on_error(transaction, e.code)
+
+        feedback = %{
+          feedback
+          | attempts: feedback.attempts + 1,
+            throttled: feedback.throttled || e.code in @throttled
+        }
+
+        run(transaction, callback, options, feedback)
+    end
+  end
+
+  @doc """
+  Returns the current `limit`, the number of `running` transactions
+  and the `queued` ones for each class.
+  """
+  @spec stats(GenServer.server()) :: %{atom => map}
+  def stats(scheduler) do
+    GenServer.call(scheduler, :stats)
+  end
+
+  @impl true
+  def init(opts) do
+    classes =
+      Keyword.get(opts, :classes, %{default: %{}})
+      |> Map.new(fn {name, class} ->
+        min = Map.get(class, :min_concurrency, 1)
+        max = Map.get(class, :max_concurrency, 100)
+
+        {name,
+         %{
+           options: class_options(class),
+           min: min,
+           max: max,
+           limit: max,
+           max_queue: Map.get(class, :max_queue, 10_000),
+           last_decrease: nil,
+           running: 0,
+           queue: :queue.new(),
+           queued: 0
+         }}
+      end)
+
+    target_latency = Keyword.get(opts, :target_latency, 100)
+    decrease_interval = Keyword.get(opts, :decrease_interval, target_latency)
+
+    {:ok,
+     %{
+       classes: classes,
+       target_latency: System.convert_time_unit(target_latency, :millisecond, :native),
+       decrease_interval: System.convert_time_unit(decrease_interval, :millisecond, :native),
+       running: %{}
+     }}
+  end
+
+  defp class_options(class) do
+    priority =
+      case Map.get(class, :priority, :default) do
+        :batch -> [Option.transaction_option_priority_batch()]
+        :default -> []
+        :immediate -> [Option.transaction_option_priority_system_immediate()]
+      end
+
+    tags = Enum.map(Map.get(class, :tags, []), &{Option.transaction_option_tag(), &1})
+    priority ++ tags
+  end
+
+  @impl true
+  def handle_call({:acquire, name}, {pid, _} = from, state) do
+    case Map.fetch(state.classes, name) do
+      :error ->
+        {:reply, {:error, :unknown_class}, state}
+
+      {:ok, class} ->
+        cond do
+          class.running < trunc(class.limit) ->
+            {reply, state} = admit(state, name, pid, System.monotonic_time())
+            {:reply, reply, state}
+
+          class.queued >= class.max_queue ->
+            {:reply, {:error, :overloaded}, state}
+
+          true ->
+            class = %{
+              class
+              | queue: :queue.in({from, System.monotonic_time()}, class.queue),
+                queued: class.queued + 1
+            }
+
+            {:noreply, put_in(state.classes[name], class)}
+        end
+    end
+  end
+
+  def handle_call(:stats, _from, state) do
+    stats =
+      Map.new(state.classes, fn {name, class} ->
+        {name, %{limit: trunc(class.limit), running: class.running, queued: class.queued}}
+      end)
+
+    {:reply, stats, state}
+  end
+
+  @impl true
+  def handle_cast({:release, ref, feedback}, state) do
+    Process.demonitor(ref, [:flush])
+    {:noreply, release(state, ref, feedback)}
+  end
+
+  @impl true
+  def handle_info({:DOWN, ref, :process, _pid, _reason}, state) do
+    {:noreply, release(state, ref, nil)}
+  end
+
+  defp admit(state, name, pid, enqueued_at) do
+    class = state.classes[name]
+    ref = Process.monitor(pid)
+
+    Telemetry.execute(
+      [:fdb, :scheduler, :admit],
+      %{wait: System.monotonic_time() - enqueued_at, queued: class.queued},
+      %{class: name}
+    )
+
+    state = put_in(state.classes[name], %{class | running: class.running + 1})
+    {{:ok, ref, class.options}, put_in(state.running[ref], name)}
+  end
+
+  defp release(state, ref, feedback) do
+    case Map.pop(state.running, ref) do
+      {nil, _} ->
+        state
+
+      {name, running} ->
+        class = state.classes[name]
+        class = adapt(%{class | running: class.running - 1}, feedback, state)
+
+        if feedback do
+          measurements = %{
+            duration: feedback.duration,
+            attempts: feedback.attempts,
+            limit: trunc(class.limit)
+          }
+
+          Telemetry.execute([:fdb, :scheduler, :stop], measurements, %{class: name})
+        end
+
+        %{state | running: running}
+        |> put_in([:classes, name], class)
+        |> dequeue(name)
+    end
+  end
+
+  defp adapt(class, nil, _state), do: class
+
+  defp adapt(class, feedback, state) do
+    now = System.monotonic_time()
+
+    cond do
+      !feedback.throttled && feedback.latency <= state.target_latency ->
+        %{class | limit: min(class.max, class.limit + 1 / class.limit)}
+
+      class.last_decrease && now - class.last_decrease < state.decrease_interval ->
+        class
+
+      true ->
+        %{class | limit: max(class.min, class.limit * 0.75), last_decrease: now}
+    end
+  end
+
+  defp dequeue(state, name) do
+    class = state.classes[name]
+
+    with true <- class.running < trunc(class.limit),
+         {{:value, {{pid, _} = from, enqueued_at}}, queue} <- :queue.out(class.queue) do
+      state = put_in(state.classes[name], %{class | queue: queue, queued: class.queued - 1})
+
+      if Process.alive?(pid) do
+        {reply, state} = admit(state, name, pid, enqueued_at)
+        GenServer.reply(from, reply)
+        dequeue(state, name)
+      else
+        dequeue(state, name)
+      end
+    else
+      _ -> state
+    end
+  end
+end
@@ -0,0 +1,31 @@
+defmodule FDB.Telemetry do
+  @moduledoc false
+
+  # :telemetry is not a dependency of this library. The events are
+  # emitted only if the application using the library depends on
+  # it. The check is cached as it involves the code server when the
+  # module is not available.
+
+  @key {__MODULE__, :enabled}
+
+  @spec execute([atom], map, map) :: :ok
+  def execute(event, measurements, metadata \\ %{}) do
+    if enabled?() do
+      apply(:telemetry, :execute, [event, measurements, metadata])
+    end
+
+    :ok
+  end
+
+  defp enabled? do
+    case :persistent_term.get(@key, nil) do
+      nil ->
+        enabled = Code.ensure_loaded?(:telemetry)
+        :persistent_term.put(@key, enabled)
+        enabled
+
+      enabled ->
+        enabled
+    end
+  end
+end
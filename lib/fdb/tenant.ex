@@ -0,0 +1,68 @@
+defmodule FDB.Tenant do
+  @moduledoc """
+  A tenant is a named key space of the database. The keys read and
+  written by the transactions of a tenant are isolated from the other
+  tenants and are stored under a prefix chosen by the cluster, which
+  also keeps the data of a tenant together on the storage servers.
+  The keys don't need a `FDB.Coder.Subspace` to be told apart.
+
+      db = FDB.Database.create(cluster_file_path, %{coder: coder})
+      :ok = FDB.Tenant.create(db, "acme")
+      acme = FDB.Tenant.open(db, "acme")
+
+      FDB.Database.transact(acme, fn t ->
+        FDB.Transaction.set(t, {"user", 42}, "alice")
+      end)
+
+  The cluster has to be configured with a tenant mode, for example
+  `fdbcli --exec "configure tenant_mode=optional_experimental"`. The
+  tenant uses the defaults (coder etc) of the database it was opened
+  from.
+  """
+  alias FDB.{Native, Utils, Database, Transaction, Option}
+
+  defstruct resource: nil, name: nil, database: nil
+
+  @type t :: %__MODULE__{resource: identifier, name: binary, database: Database.t()}
+
+  @tenant_map "\xff\xff/management/tenant_map/"
+
+  @doc """
+  Opens the tenant with the given name. The tenant is not checked to
+  exist, the transactions of a missing tenant fail with
+  `tenant_not_found` error.
+  """
+  @spec open(Database.t(), binary) :: t
+  def open(%Database{} = database, name) when is_binary(name) do
+    resource =
+      Native.database_open_tenant(database.resource, name)
+      |> Utils.verify_result()
+
+    %__MODULE__{resource: resource, name: name, database: database}
+  end
+
+  @doc """
+  Creates the tenant in the cluster.
+  """
+  @spec create(Database.t(), binary) :: :ok
+  def create(%Database{} = database, name) when is_binary(name) do
+    manage(database, &Transaction.set(&1, @tenant_map <> name, "", %{coder: raw_coder()}))
+  end
+
+  @doc """
+  Deletes the tenant from the cluster. The tenant must be empty.
+  """
+  @spec delete(Database.t(), binary) :: :ok
+  def delete(%Database{} = database, name) when is_binary(name) do
+    manage(database, &Transaction.clear(&1, @tenant_map <> name, %{coder: raw_coder()}))
+  end
+
+  defp manage(database, callback) do
+    Database.transact(database, fn t ->
+      :ok = Transaction.set_option(t, Option.transaction_option_special_key_space_enable_writes())
+      callback.(t)
+    end)
+  end
+
+  defp raw_coder, do: Transaction.Coder.new()
+end
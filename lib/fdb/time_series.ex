@@ -0,0 +1,283 @@
+defmodule FDB.TimeSeries do
+  @moduledoc """
+  Integer time series with pre-aggregated rollups.
+
+      ts = FDB.TimeSeries.new("metrics")
+
+      FDB.Database.transact(db, fn t ->
+        FDB.TimeSeries.add(t, ts, "api.latency", System.os_time(:second), 42)
+      end)
+
+      FDB.Database.transact(db, fn t ->
+        FDB.TimeSeries.aggregate(t, ts, "api.latency", from, to)
+      end)
+      # => %{count: 1440, sum: 60480, min: 3, max: 812}
+
+  Every point is stored as is, and along with it the `count`, `sum`,
+  `min` and `max` of the bucket which contains the point are updated
+  for each resolution (1 minute, 1 hour and 1 day by default) in the
+  same transaction. The rollups are updated with
+  `FDB.Option.mutation_type_add/0`, `FDB.Option.mutation_type_min/0`
+  and `FDB.Option.mutation_type_max/0`, so concurrent writers never
+  conflict.
+
+  `aggregate/6` splits the time range into the largest buckets that
+  fit in it and reads their rollups, the points are read only for the
+  parts at the edges which are smaller than the finest resolution. A
+  query over a year reads a few hundred keys instead of every point.
+
+  The timestamps are integers, in the unit of the resolutions. The
+  values are 64 bit signed integers.
+  """
+  alias FDB.{Transaction, KeySelector, KeySelectorRange, KeyRange, Option, Versionstamp}
+  alias FDB.Coder
+
+  defstruct [:points, :rollups, :resolutions]
+
+  @type t :: %__MODULE__{}
+
+  @type aggregate :: %{
+          count: non_neg_integer,
+          sum: integer,
+          min: integer | nil,
+          max: integer | nil
+        }
+
+  @count 0
+  @sum 1
+  @min 2
+  @max 3
+
+  # min and max compare the values as unsigned integers
+  @offset 0x8000000000000000
+
+  @doc """
+  Creates a time series store under the given prefix. The prefix can
+  be a raw binary or a directory.
+
+  ## Options
+
+  * `:series_coder` - (`t:FDB.Coder.t/0`) coder of the series
+    name. Defaults to `FDB.Coder.ByteString`.
+  * `:resolutions` - ([integer]) bucket sizes of the rollups. Defaults
+    to `[60, 3600, 86400]`.
+  """
+  @spec new(binary | FDB.Directory.t(), map) :: t
+  def new(prefix, options \\ %{}) do
+    series = Map.get(options, :series_coder, Coder.ByteString.new())
+
+    points =
+      Transaction.Coder.new(
+        Coder.Subspace.new(
+          prefix,
+          Coder.Tuple.new(
+            {series, Coder.Integer.new(), Coder.Integer.new(), Coder.Versionstamp.new()}
+          )
+        ),
+        Coder.SignedLittleEndianInteger.new(64)
+      )
+
+    rollups =
+      Transaction.Coder.new(
+        Coder.Subspace.new(
+          prefix,
+          Coder.Tuple.new(
+            {series, Coder.Integer.new(), Coder.Integer.new(), Coder.Integer.new()}
+          )
+        )
+      )
+
+    resolutions = Map.get(options, :resolutions, [60, 3600, 86400])
+
+    unless resolutions != [] && Enum.all?(resolutions, &(is_integer(&1) && &1 > 0)) do
+      raise ArgumentError, "Invalid resolutions: #{inspect(resolutions)}"
+    end
+
+    %__MODULE__{
+      points: points,
+      rollups: rollups,
+      resolutions: Enum.sort(resolutions, &>=/2)
+    }
+  end
+
+  @doc """
+  Adds a point to the series. Refer `add_all/4`.
+  """
+  @spec add(Transaction.t(), t, any, integer, integer) :: :ok
+  def add(%Transaction{} = transaction, %__MODULE__{} = ts, series, timestamp, value) do
+    add_all(transaction, ts, series, [{timestamp, value}])
+  end
+
+  @doc """
+  Adds `{timestamp, value}` points to the series and updates the
+  rollups.
+  """
+  @spec add_all(Transaction.t(), t, any, [{integer, integer}]) :: :ok
+  def add_all(%Transaction{} = transaction, %__MODULE__{} = ts, series, points)
+      when is_list(points) do
+    first = Transaction.reserve_user_versions(transaction, length(points))
+
+    points
+    |> Enum.with_index(first)
+    |> Enum.each(fn {{timestamp, value}, user_version}
+                    when is_integer(timestamp) and is_integer(value) ->
+      :ok =
+        Transaction.set_versionstamped_key(
+          transaction,
+          {series, 0, timestamp, Versionstamp.incomplete(user_version)},
+          value,
+          %{coder: ts.points}
+        )
+
+      Enum.each(ts.resolutions, fn resolution ->
+        bucket = bucket(timestamp, resolution)
+        stored = <<value + @offset::little-unsigned-64>>
+
+        [
+          {@count, Option.mutation_type_add(), <<1::little-64>>},
+          {@sum, Option.mutation_type_add(), <<value::little-signed-64>>},
+          {@min, Option.mutation_type_min(), stored},
+          {@max, Option.mutation_type_max(), stored}
+        ]
+        |> Enum.each(fn {field, operation_type, param} ->
+          key = {series, resolution, bucket, field}
+          options = %{coder: ts.rollups}
+          :ok = Transaction.atomic_op(transaction, key, operation_type, param, options)
+        end)
+      end)
+    end)
+  end
+
+  @doc """
+  Returns the `count`, `sum`, `min` and `max` of the points with
+  timestamp in `[from, to)`. `min` and `max` are `nil` if there are no
+  points.
+
+  ## Options
+
+  * `:snapshot` - (boolean) Defaults to `false`.
+  """
+  @spec aggregate(Transaction.t(), t, any, integer, integer, map) :: aggregate
+  def aggregate(
+        %Transaction{} = transaction,
+        %__MODULE__{} = ts,
+        series,
+        from,
+        to,
+        options \\ %{}
+      )
+      when is_integer(from) and is_integer(to) do
+    plan(from, to, ts.resolutions)
+    |> Enum.reduce(empty(), fn
+      {:points, from, to}, acc ->
+        read(transaction, ts.points, {series, 0, from}, {series, 0, to}, options)
+        |> Enum.reduce(acc, fn {_key, value}, acc -> add_value(acc, value) end)
+
+      {resolution, from, to}, acc ->
+        begin_key = {series, resolution, from}
+        end_key = {series, resolution, to}
+
+        read(transaction, ts.rollups, begin_key, end_key, options)
+        |> Enum.reduce(acc, &add_rollup/2)
+    end)
+  end
+
+  @doc """
+  Returns the rollups of the buckets of the given resolution which
+  start in `[from, to)`, as a list of `{bucket_start, aggregate}`. The
+  buckets without points are skipped.
+
+  ## Options
+
+  * `:snapshot` - (boolean) Defaults to `false`.
+  """
+  @spec buckets(Transaction.t(), t, any, integer, integer, integer, map) :: [
+          {integer, aggregate}
+        ]
+  def buckets(
+        %Transaction{} = transaction,
+        %__MODULE__{} = ts,
+        series,
+        resolution,
+        from,
+        to,
+        options \\ %{}
+      ) do
+    unless resolution in ts.resolutions do
+      raise ArgumentError, "Unknown resolution: #{inspect(resolution)}"
+    end
+
+    read(transaction, ts.rollups, {series, resolution, from}, {series, resolution, to}, options)
+    |> Enum.chunk_by(fn {{_, _, bucket, _}, _} -> bucket end)
+    |> Enum.map(fn [{{_, _, bucket, _}, _} | _] = rollups ->
+      {bucket, Enum.reduce(rollups, empty(), &add_rollup/2)}
+    end)
+  end
+
+  @doc """
+  Removes all the points and rollups of the series.
+  """
+  @spec clear(Transaction.t(), t, any) :: :ok
+  def clear(%Transaction{} = transaction, %__MODULE__{} = ts, series) do
+    Transaction.clear_range(transaction, KeyRange.starts_with({series}), %{coder: ts.rollups})
+  end
+
+  @doc false
+  # Splits [from, to) into the coarsest aligned buckets, leaving the
+  # edges to the finer resolutions and finally to the points.
+  def plan(from, to, _resolutions) when from >= to, do: []
+  def plan(from, to, []), do: [{:points, from, to}]
+
+  def plan(from, to, [resolution | finer]) do
+    first = from + Integer.mod(-from, resolution)
+    last = bucket(to, resolution)
+
+    if first < last do
+      plan(from, first, finer) ++ [{resolution, first, last}] ++ plan(last, to, finer)
+    else
+      plan(from, to, finer)
+    end
+  end
+
+  defp bucket(timestamp, resolution), do: timestamp - Integer.mod(timestamp, resolution)
+
+  defp read(transaction, coder, begin_key, end_key, options) do
+    range =
+      KeySelectorRange.range(
+        KeySelector.first_greater_or_equal(begin_key, %{prefix: :first}),
+        KeySelector.first_greater_or_equal(end_key, %{prefix: :first})
+      )
+
+    Transaction.get_range_stream(transaction, range, %{
+      coder: coder,
+      snapshot: Map.get(options, :snapshot, false),
+      mode: Option.streaming_mode_want_all()
+    })
+  end
+
+  defp empty, do: %{count: 0, sum: 0, min: nil, max: nil}
+
+  defp add_value(acc, value) do
+    %{acc | count: acc.count + 1, sum: acc.sum + value}
+    |> add_min(value)
+    |> add_max(value)
+  end
+
+  defp add_rollup({{_, _, _, @count}, <<n::little-signed-64>>}, acc),
+    do: %{acc | count: acc.count + n}
+
+  defp add_rollup({{_, _, _, @sum}, <<n::little-signed-64>>}, acc),
+    do: %{acc | sum: acc.sum + n}
+
+  defp add_rollup({{_, _, _, @min}, <<n::little-unsigned-64>>}, acc),
+    do: add_min(acc, n - @offset)
+
+  defp add_rollup({{_, _, _, @max}, <<n::little-unsigned-64>>}, acc),
+    do: add_max(acc, n - @offset)
+
+  defp add_min(%{min: min} = acc, value) when is_nil(min) or value < min, do: %{acc | min: value}
+  defp add_min(acc, _value), do: acc
+
+  defp add_max(%{max: max} = acc, value) when is_nil(max) or value > max, do: %{acc | max: value}
+  defp add_max(acc, _value), do: acc
+end
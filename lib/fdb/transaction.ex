@@ -7,27 +7,46 @@ defmodule FDB.Transaction do
   alias FDB.KeySelectorRange
   alias FDB.Transaction
   alias FDB.Database
+  alias FDB.Tenant
   alias FDB.Transaction.Coder
   alias FDB.Option
   alias FDB.RangeResult
 
-  defstruct resource: nil, coder: nil, snapshot: 0
-  @type t :: %__MODULE__{resource: identifier, coder: Transaction.Coder.t(), snapshot: integer}
+  defstruct resource: nil, coder: nil, snapshot: 0, user_versions: nil
+
+  @type t :: %__MODULE__{
+          resource: identifier,
+          coder: Transaction.Coder.t(),
+          snapshot: integer,
+          user_versions: :atomics.atomics_ref()
+        }
 
   @doc """
-  Creates a new transaction.
+  Creates a new transaction. A transaction created from a
+  `t:FDB.Tenant.t/0` reads and writes the keys of the tenant and uses
+  the defaults of the database the tenant was opened from.
   """
-  @spec create(Database.t(), map) :: t
-  def create(%Database{} = database, defaults \\ %{}) when is_map(defaults) do
-    resource =
-      Native.database_create_transaction(database.resource)
-      |> Utils.verify_result()
+  @spec create(Database.t() | Tenant.t(), map) :: t
+  def create(database_or_tenant, defaults \\ %{})
+
+  def create(%Database{} = database, defaults) when is_map(defaults) do
+    Native.database_create_transaction(database.resource)
+    |> Utils.verify_result()
+    |> build(database, defaults)
+  end
 
+  def create(%Tenant{} = tenant, defaults) when is_map(defaults) do
+    Native.tenant_create_transaction(tenant.resource)
+    |> Utils.verify_result()
+    |> build(tenant.database, defaults)
+  end
+
+  defp build(resource, database, defaults) do
     defaults = Utils.normalize_bool_values(defaults, [:snapshot])
 
     struct!(__MODULE__, Map.take(database, [:coder]))
     |> struct!(defaults)
-    |> struct!(%{resource: resource})
+    |> struct!(%{resource: resource, user_versions: :atomics.new(1, [])})
   end
 
   @doc """
@@ -93,6 +112,32 @@ defmodule FDB.Transaction do
     |> Future.map(&Coder.decode_value(coder, &1))
   end
 
+  defp do_get_range(
+         %Transaction{} = transaction,
+         begin_key_selector,
+         end_key_selector,
+         %{mapper: mapper} = options
+       ) do
+    Native.transaction_get_mapped_range(
+      transaction.resource,
+      begin_key_selector.key,
+      begin_key_selector.or_equal,
+      begin_key_selector.offset,
+      end_key_selector.key,
+      end_key_selector.or_equal,
+      end_key_selector.offset,
+      mapper,
+      Map.get(options, :limit, 0),
+      Map.get(options, :target_bytes, 0),
+      Map.get(options, :mode, FDB.Option.streaming_mode_iterator()),
+      Map.get(options, :iteration, 1),
+      Map.get(options, :snapshot, transaction.snapshot),
+      Map.get(options, :reverse, 0)
+    )
+    |> Future.create()
+    |> Future.await()
+  end
+
   defp do_get_range(%Transaction{} = transaction, begin_key_selector, end_key_selector, options) do
     Native.transaction_get_range(
       transaction.resource,
@@ -113,14 +158,23 @@ defmodule FDB.Transaction do
     |> Future.await()
   end
 
-  defp decode_range_items(coder, items) do
-    Enum.map(items, fn {key, value} ->
-      key = Coder.decode_key(coder, key)
-      value = Coder.decode_value(coder, value)
-      {key, value}
+  defp decode_range_items(%{mapper: _} = state, items) do
+    Enum.map(items, fn {key, value, range} ->
+      {key, value} = decode_range_item(state.coder, {key, value})
+      {key, value, Enum.map(range, &decode_range_item(state.mapped_coder, &1))}
     end)
   end
 
+  defp decode_range_items(state, items) do
+    Enum.map(items, &decode_range_item(state.coder, &1))
+  end
+
+  defp decode_range_item(coder, {key, value}) do
+    key = Coder.decode_key(coder, key)
+    value = Coder.decode_value(coder, value)
+    {key, value}
+  end
+
   defp do_get_range_with_continuation(
          %Transaction{} = transaction,
          state
@@ -147,12 +201,12 @@ defmodule FDB.Transaction do
         has_more
       end
 
-    key_values = decode_range_items(state.coder, list)
+    key_values = decode_range_items(state, list)
 
     if has_more == 0 do
       %RangeResult{has_more: false, key_values: key_values}
     else
-      {key, _value} = List.last(list)
+      key = elem(List.last(list), 0)
 
       {begin_key_selector, end_key_selector} =
         if state.reverse == 0 do
@@ -266,6 +320,77 @@ defmodule FDB.Transaction do
     do_get_range_with_continuation(transaction, state)
   end
 
+  @doc """
+  Reads the key-value pairs in the given range like `get_range/3` and
+  for each pair, reads the secondary range derived from it using the
+  `mapper`, all in a single request to the storage server. This is
+  useful for index lookups, where the index entries are read along
+  with the records they point to.
+
+  The mapper is a tuple which is matched against the key and value of
+  each pair. `{K[i]}` and `{V[i]}` elements are replaced with the i-th
+  element of the key and value tuples, and a trailing `{...}` element
+  turns the mapper into a prefix range. The mapper could be either a
+  raw binary or a `{value, coder}` pair, which is encoded using the
+  `t:FDB.Coder.t/0`.
+
+      string = Coder.UnicodeString.new()
+      integer = Coder.Integer.new()
+
+      # {"index", name, id} => ""
+      index = Transaction.Coder.new(Coder.Tuple.new({string, string, integer}))
+      # {"record", id, field} => value
+      records = Transaction.Coder.new(Coder.Tuple.new({string, integer, string}))
+      mapper = {{"record", "{K[2]}", "{...}"}, Coder.Tuple.new({string, string, string})}
+
+      Transaction.get_mapped_range(
+        t,
+        KeySelectorRange.starts_with({"index", "alice"}),
+        mapper,
+        %{coder: index, mapped_coder: records, snapshot: true}
+      )
+
+  Each item in `key_values` of the returned `t:FDB.RangeResult.t/0`
+  is a `{key, value, key_values}` tuple, where `key_values` is the
+  list of key-value pairs of the secondary range.
+
+  As the keys are decoded as tuples by the server, the keys in the
+  range (including any subspace prefix) must be tuple encoded. The
+  server (7.1) supports mapped range reads only with `snapshot: true`
+  and with `FDB.Option.transaction_option_read_your_writes_disable/0`
+  set on the transaction.
+
+  ## Options
+
+  Supports all the options of `get_range/3` and
+
+  * `:mapped_coder` - (`t:FDB.Transaction.Coder.t/0`) the coder of the
+    secondary range key-value pairs. Defaults to the coder of the
+    transaction.
+  """
+  @spec get_mapped_range(t, KeySelectorRange.t(), binary | {any, FDB.Coder.t()}, map) ::
+          RangeResult.t()
+  def get_mapped_range(
+        %Transaction{} = transaction,
+        %KeySelectorRange{} = key_selector_range,
+        mapper,
+        options \\ %{}
+      )
+      when is_map(options) do
+    mapper =
+      case mapper do
+        mapper when is_binary(mapper) -> mapper
+        {value, %FDB.Coder{module: module, opts: opts}} -> module.encode(value, opts)
+      end
+
+    options =
+      options
+      |> Map.put(:mapper, mapper)
+      |> Map.put(:mapped_coder, Map.get(options, :mapped_coder, transaction.coder))
+
+    get_range(transaction, key_selector_range, options)
+  end
+
   @doc """
   See `get_range/3` for options
 
@@ -273,19 +398,20 @@ defmodule FDB.Transaction do
   using `get_range/3` function. This is suitable for iterating over
   large list of key value pair.
   """
-  @spec get_range_stream(t | Database.t(), KeySelectorRange.t(), map) :: Enumerable.t()
+  @spec get_range_stream(t | Database.t() | Tenant.t(), KeySelectorRange.t(), map) ::
+          Enumerable.t()
   def get_range_stream(
         %{__struct__: struct} = transaction,
         %KeySelectorRange{} = key_selector_range,
         options \\ %{}
       )
-      when is_map(options) and struct in [Transaction, Database] do
+      when is_map(options) and struct in [Transaction, Database, Tenant] do
     database_or_transaction = transaction
 
     with_transaction = fn cb ->
       fn ->
         case database_or_transaction do
-          %Database{} ->
+          %{__struct__: struct} when struct in [Database, Tenant] ->
             Database.transact(database_or_transaction, fn t ->
               cb.(t)
             end)
@@ -613,6 +739,23 @@ defmodule FDB.Transaction do
     end
   end
 
+  @doc false
+  # Reserves `count` consecutive user versions for the incomplete
+  # versionstamps of the transaction and returns the first one, so
+  # that separate calls in a transaction, from any process, don't
+  # overwrite each other's keys.
+  @spec reserve_user_versions(t, non_neg_integer) :: non_neg_integer
+  def reserve_user_versions(%Transaction{user_versions: user_versions}, count)
+      when is_integer(count) and count >= 0 do
+    next = :atomics.add_get(user_versions, 1, count)
+
+    if next > 0x10000 do
+      raise ArgumentError, "More than 65536 incomplete versionstamps in the transaction"
+    end
+
+    next - count
+  end
+
   @doc """
   Same as set, but replaces the placeholder versionstamp in the value
 
@@ -836,6 +979,9 @@ defmodule FDB.Transaction do
   """
   @spec on_error_q(t, integer) :: Future.t()
   def on_error_q(%Transaction{} = transaction, code) when is_integer(code) do
+    # the transaction is reset on retry
+    :ok = :atomics.put(transaction.user_versions, 1, 0)
+
     Native.transaction_on_error(transaction.resource, code)
     |> Future.create()
   end
@@ -944,6 +1090,40 @@ defmodule FDB.Transaction do
     |> Utils.verify_ok()
   end
 
+  @conflicting_keys_prefix "\xff\xff/transaction/conflicting_keys/"
+
+  @doc """
+  Returns the key ranges which caused the last commit of the
+  transaction to fail with `not_committed` (1020) error, as a list of
+  `{begin_key, end_key}` raw keys.
+
+  `FDB.Option.transaction_option_report_conflicting_keys/0` must be
+  set before the commit and this function must be called before
+  `on_error/2`, which resets the transaction.
+  """
+  @spec get_conflicting_keys(t) :: [{binary, binary}]
+  def get_conflicting_keys(%Transaction{} = transaction) do
+    range =
+      KeySelectorRange.range(
+        KeySelector.first_greater_or_equal(@conflicting_keys_prefix),
+        KeySelector.first_greater_or_equal(@conflicting_keys_prefix <> "\xff\xff")
+      )
+
+    get_range_stream(transaction, range, %{coder: Transaction.Coder.new()})
+    |> Enum.map(fn {@conflicting_keys_prefix <> key, marker} -> {key, marker} end)
+    |> conflicting_ranges()
+  end
+
+  # A range starts with a key whose value is "1" and ends with the
+  # next key whose value is "0"
+  defp conflicting_ranges([{begin_key, "1"}, {end_key, "0"} | rest]) do
+    [{begin_key, end_key} | conflicting_ranges(rest)]
+  end
+
+  defp conflicting_ranges([{begin_key, "1"}]), do: [{begin_key, "\xff"}]
+  defp conflicting_ranges([_ | rest]), do: conflicting_ranges(rest)
+  defp conflicting_ranges([]), do: []
+
   @metadata_version_key "\xff/metadataVersion"
   @metadata_version_required_value "\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00"
 
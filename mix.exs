@@ -10,6 +10,7 @@ defmodule FDB.MixProject do
       compilers: [:elixir_make] ++ Mix.compilers(),
       version: @version,
       elixir: "~> 1.3",
+      elixirc_paths: elixirc_paths(Mix.env()),
       start_permanent: Mix.env() == :prod,
       deps: deps(),
       description: "FoundationDB client",
@@ -29,6 +30,9 @@ defmodule FDB.MixProject do
     ]
   end
 
+  defp elixirc_paths(:dev), do: ["lib", "bench"]
+  defp elixirc_paths(_), do: ["lib"]
+
   defp deps do
     [
       {:elixir_make, "~> 0.4", runtime: false},
@@ -0,0 +1,81 @@
+defmodule FDB.BlobTest do
+  use ExUnit.Case, async: false
+  alias FDB.Database
+  alias FDB.Blob
+  import TestUtils
+
+  setup do
+    flushdb()
+  end
+
+  test "put and get" do
+    db = new_database()
+    blobs = Blob.new("blobs", %{chunk_size: 100})
+    data = random_value(1050)
+
+    Database.transact(db, fn t -> Blob.put(t, blobs, "a", data) end)
+    Database.transact(db, fn t -> Blob.put(t, blobs, "empty", "") end)
+
+    Database.transact(db, fn t ->
+      assert Blob.get(t, blobs, "a") == data
+      assert Blob.get(t, blobs, "empty") == ""
+      assert Blob.get(t, blobs, "missing") == nil
+    end)
+
+    assert Blob.size(db, blobs, "a") == 1050
+    assert Blob.size(db, blobs, "missing") == nil
+
+    Database.transact(db, fn t -> Blob.put(t, blobs, "a", "short") end)
+    Database.transact(db, fn t -> assert Blob.get(t, blobs, "a") == "short" end)
+
+    Database.transact(db, fn t -> Blob.delete(t, blobs, "a") end)
+    Database.transact(db, fn t -> assert Blob.get(t, blobs, "a") == nil end)
+  end
+
+  test "write and stream" do
+    db = new_database()
+    blobs = Blob.new("blobs", %{chunk_size: 100})
+    data = random_value(5000)
+
+    parts = for <<part::binary-size(333) <- binary_part(data, 0, 4995)>>, do: part
+    :ok = Blob.write(db, blobs, "a", parts ++ [binary_part(data, 4995, 5)], %{batch_bytes: 1000})
+
+    assert Blob.size(db, blobs, "a") == 5000
+    assert Blob.stream(db, blobs, "a") |> Enum.to_list() |> IO.iodata_to_binary() == data
+
+    for {offset, length} <- [{0, 1}, {99, 2}, {150, 1000}, {4990, 100}, {6000, 10}] do
+      expected = binary_part(data, min(offset, 5000), min(length, max(5000 - offset, 0)))
+
+      actual =
+        Blob.stream(db, blobs, "a", %{offset: offset, length: length, concurrency: 3})
+        |> Enum.to_list()
+        |> IO.iodata_to_binary()
+
+      assert actual == expected
+
+      actual =
+        Database.transact(db, fn t ->
+          Blob.stream(t, blobs, "a", %{offset: offset, length: length})
+          |> Enum.to_list()
+          |> IO.iodata_to_binary()
+        end)
+
+      assert actual == expected
+    end
+
+    :ok = Blob.write(db, blobs, "a", "replaced")
+    assert Blob.stream(db, blobs, "a") |> Enum.to_list() == ["replaced"]
+    assert Blob.stream(db, blobs, "missing") |> Enum.to_list() == []
+  end
+
+  test "stream raises when the blob is replaced" do
+    db = new_database()
+    blobs = Blob.new("blobs", %{chunk_size: 10})
+    :ok = Blob.write(db, blobs, "a", random_value(100))
+
+    assert_raise RuntimeError, fn ->
+      Blob.stream(db, blobs, "a", %{concurrency: 1})
+      |> Enum.each(fn _ -> :ok = Blob.write(db, blobs, "a", random_value(100)) end)
+    end
+  end
+end
@@ -0,0 +1,67 @@
+defmodule FDB.Coder.CompressedTest do
+  alias FDB.Coder.Compressed
+  alias FDB.Coder.Identity
+  alias FDB.Coder.UnicodeString
+
+  use ExUnit.Case
+  use ExUnitProperties
+
+  defp round_trip(coder, value) do
+    encoded = coder.module.encode(value, coder.opts)
+    assert coder.module.decode(encoded, coder.opts) == {value, <<>>}
+    encoded
+  end
+
+  property "encode / decode" do
+    check all binaries <- list_of(binary()) do
+      coder = Compressed.new(Identity.new(), %{threshold: 8})
+      assert_coder_symmetry(coder, binaries)
+
+      coder = Compressed.new(Identity.new(), %{dictionaries: %{3 => "dictionary"}})
+      assert_coder_symmetry(coder, binaries)
+    end
+  end
+
+  defp assert_coder_symmetry(coder, values) do
+    Enum.each(values, &round_trip(coder, &1))
+  end
+
+  test "threshold" do
+    coder = Compressed.new(UnicodeString.new(), %{threshold: 100})
+    small = String.duplicate("a", 50)
+    large = String.duplicate("a", 500)
+
+    assert byte_size(round_trip(coder, small)) > 50
+    assert byte_size(round_trip(coder, large)) < 100
+  end
+
+  test "dictionary" do
+    dictionary = ~s({"name": "", "email": "", "created_at": ""})
+    value = ~s({"name": "alice", "email": "alice@example.com", "created_at": "2020-01-01"})
+
+    plain = Compressed.new(Identity.new(), %{threshold: 0})
+    v1 = Compressed.new(Identity.new(), %{threshold: 0, dictionaries: %{1 => dictionary}})
+
+    assert byte_size(round_trip(v1, value)) < byte_size(round_trip(plain, value))
+
+    v2 =
+      Compressed.new(Identity.new(), %{
+        threshold: 0,
+        dictionaries: %{1 => dictionary, 2 => String.reverse(dictionary)}
+      })
+
+    encoded = v1.module.encode(value, v1.opts)
+    assert v2.module.decode(encoded, v2.opts) == {value, <<>>}
+    assert_raise ArgumentError, fn -> plain.module.decode(encoded, plain.opts) end
+  end
+
+  test "max size" do
+    value = String.duplicate("a", 10_000)
+    coder = Compressed.new(Identity.new(), %{max_size: 5_000})
+    encoded = coder.module.encode(value, coder.opts)
+
+    assert_raise ArgumentError, fn -> coder.module.decode(encoded, coder.opts) end
+    # the stream is usable after the failed decode
+    assert round_trip(coder, String.duplicate("b", 4_000))
+  end
+end
@@ -0,0 +1,63 @@
+defmodule FDB.ConflictTrackerTest do
+  use ExUnit.Case, async: false
+  alias FDB.Transaction
+  alias FDB.Database
+  alias FDB.ConflictTracker
+  import TestUtils
+
+  setup do
+    flushdb()
+  end
+
+  test "keeps the most frequent ranges" do
+    {:ok, tracker} = ConflictTracker.start_link(capacity: 2, report_interval: nil)
+
+    :ok = ConflictTracker.record(tracker, [{"a", "a\0"}, {"b", "b\0"}])
+    :ok = ConflictTracker.record(tracker, [{"a", "a\0"}])
+    :ok = ConflictTracker.record(tracker, [{"c", "c\0"}])
+
+    assert ConflictTracker.top(tracker) == [
+             %{begin: "a", end: "a\0", count: 2, error: 0},
+             %{begin: "c", end: "c\0", count: 2, error: 1}
+           ]
+
+    assert ConflictTracker.top(tracker, 1) == [%{begin: "a", end: "a\0", count: 2, error: 0}]
+    :ok = ConflictTracker.reset(tracker)
+    assert ConflictTracker.top(tracker) == []
+  end
+
+  test "records conflicting keys in transact" do
+    {:ok, tracker} = ConflictTracker.start_link(report_interval: nil)
+    db = new_database()
+    tracked_db = Database.set_defaults(db, %{conflict_tracker: tracker})
+    attempts = :counters.new(1, [])
+
+    Database.transact(tracked_db, fn t ->
+      :counters.add(attempts, 1, 1)
+      _ = Transaction.get(t, "hot")
+
+      if :counters.get(attempts, 1) == 1 do
+        Database.transact(db, fn t2 -> Transaction.set(t2, "hot", "other") end)
+      end
+
+      Transaction.set(t, "cold", "value")
+    end)
+
+    assert :counters.get(attempts, 1) == 2
+    assert [%{begin: "hot", end: "hot\0", count: 1}] = ConflictTracker.top(tracker)
+  end
+
+  test "conflicting keys" do
+    db = new_database()
+    t1 = Transaction.create(db)
+    :ok = Transaction.set_option(t1, FDB.Option.transaction_option_report_conflicting_keys())
+    _ = Transaction.get(t1, "a")
+    _ = Transaction.get(t1, "b")
+
+    Database.transact(db, fn t2 -> Transaction.set(t2, "b", "b") end)
+
+    Transaction.set(t1, "c", "c")
+    assert_raise FDB.Error, ~r/conflict/, fn -> Transaction.commit(t1) end
+    assert Transaction.get_conflicting_keys(t1) == [{"b", "b\0"}]
+  end
+end
@@ -0,0 +1,74 @@
+defmodule FDB.CounterTest do
+  use ExUnit.Case, async: false
+  alias FDB.Database
+  alias FDB.Transaction
+  alias FDB.KeySelectorRange
+  alias FDB.Counter
+  import TestUtils
+
+  setup do
+    flushdb()
+  end
+
+  defp shard_count(db, counter) do
+    Database.transact(db, fn t ->
+      Transaction.get_range(t, KeySelectorRange.starts_with(nil), %{coder: counter.coder}).key_values
+      |> length()
+    end)
+  end
+
+  test "add and get" do
+    db = new_database()
+    counter = Counter.new("counter", %{shards: 4})
+
+    assert Counter.get(db, counter) == 0
+
+    Database.transact(db, fn t ->
+      :ok = Counter.add(t, counter, 5)
+      :ok = Counter.add(t, counter, -2, %{shard: :scheduler})
+      :ok = Counter.add(t, counter, 10, %{shard: 3})
+    end)
+
+    assert Counter.get(db, counter) == 13
+    assert Counter.get(db, counter, %{snapshot: true}) == 13
+  end
+
+  test "concurrent increments" do
+    db = new_database()
+    counter = Counter.new("counter")
+
+    1..20
+    |> Enum.map(fn _ ->
+      Task.async(fn ->
+        Enum.each(1..10, fn _ ->
+          Database.transact(db, fn t -> Counter.add(t, counter, 1) end)
+        end)
+      end)
+    end)
+    |> Enum.each(&Task.await/1)
+
+    assert Counter.get(db, counter) == 200
+  end
+
+  test "compact" do
+    db = new_database()
+    counter = Counter.new("counter", %{shards: 8})
+
+    Database.transact(db, fn t ->
+      Enum.each(0..7, &Counter.add(t, counter, &1 + 1, %{shard: &1}))
+    end)
+
+    assert shard_count(db, counter) == 8
+    :ok = Counter.compact(db, counter)
+    assert shard_count(db, counter) == 1
+    assert Counter.get(db, counter) == 36
+
+    {:ok, compactor} =
+      Counter.Compactor.start_link(database: db, counters: [counter], interval: 60_000)
+
+    Database.transact(db, fn t -> Counter.add(t, counter, -6, %{shard: 5}) end)
+    :ok = Counter.Compactor.compact(compactor)
+    assert shard_count(db, counter) == 1
+    assert Counter.get(db, counter) == 30
+  end
+end
@@ -0,0 +1,102 @@
+defmodule FDB.LocalitySchedulerTest do
+  use ExUnit.Case, async: false
+  alias FDB.Database
+  alias FDB.Transaction
+  alias FDB.KeyRange
+  alias FDB.KeySelector
+  alias FDB.KeySelectorRange
+  alias FDB.LocalityScheduler
+  import TestUtils
+
+  setup do
+    flushdb()
+  end
+
+  test "limits the tasks per server" do
+    servers = ["10.0.0.1:4500", "10.0.0.2:4500", "10.0.0.3:4500"]
+
+    shards =
+      Enum.map(1..12, fn i ->
+        {KeyRange.range("k#{i}", "k#{i + 1}"), [Enum.at(servers, rem(i, 3))]}
+      end)
+
+    load = :ets.new(:load, [:public])
+    log = :ets.new(:log, [:public, :bag])
+    Enum.each(servers, &:ets.insert(load, {&1, 0}))
+
+    results =
+      LocalityScheduler.run(
+        shards,
+        fn range, [server] ->
+          :ets.insert(log, {server, :ets.update_counter(load, server, {2, 1})})
+          Process.sleep(20)
+          :ets.update_counter(load, server, {2, -1})
+          range.begin.key
+        end,
+        %{concurrency: 10, per_server: 2}
+      )
+
+    assert results == Enum.map(1..12, &"k#{&1}")
+    assert Enum.map(servers, &Enum.max(:ets.lookup_element(log, &1, 2))) == [2, 2, 2]
+  end
+
+  test "limits the shards without addresses" do
+    shards = Enum.map(1..4, fn i -> {KeyRange.range("k#{i}", "k#{i + 1}"), []} end)
+    load = :ets.new(:load, [:public])
+    log = :ets.new(:log, [:public, :bag])
+    :ets.insert(load, {:load, 0})
+
+    LocalityScheduler.run(
+      shards,
+      fn _range, [] ->
+        :ets.insert(log, {:load, :ets.update_counter(load, :load, {2, 1})})
+        Process.sleep(20)
+        :ets.update_counter(load, :load, {2, -1})
+      end,
+      %{concurrency: 4, per_server: 1}
+    )
+
+    assert Enum.max(:ets.lookup_element(log, :load, 2)) == 1
+  end
+
+  test "validates the options" do
+    shards = [{KeyRange.range("a", "b"), ["10.0.0.1:4500"]}]
+
+    Enum.each([%{concurrency: 0}, %{per_server: -1}, %{per_server: 1.5}], fn options ->
+      assert_raise ArgumentError, fn ->
+        LocalityScheduler.run(shards, fn _, _ -> :ok end, options)
+      end
+    end)
+  end
+
+  test "splits a range by storage server" do
+    db = new_database()
+    value = random_value(1000)
+
+    Enum.chunk_every(1..500, 100)
+    |> Enum.each(fn keys ->
+      Database.transact(db, fn t ->
+        Enum.each(keys, fn i ->
+          Transaction.set(t, "fdb:" <> String.pad_leading("#{i}", 3, "0"), value)
+        end)
+      end)
+    end)
+
+    shards = LocalityScheduler.shards(db, KeyRange.starts_with("fdb:"), %{chunk_size: 10_000})
+    assert Enum.all?(shards, fn {_range, addresses} -> addresses != [] end)
+
+    counts =
+      LocalityScheduler.run(shards, fn range, _addresses ->
+        Database.get_range_stream(
+          db,
+          KeySelectorRange.range(
+            KeySelector.first_greater_or_equal(range.begin.key),
+            KeySelector.first_greater_or_equal(range.end.key)
+          )
+        )
+        |> Enum.count()
+      end)
+
+    assert Enum.sum(counts) == 500
+  end
+end
@@ -21,6 +21,30 @@ defmodule FDB.NativeTest do
     assert select_api_version_impl(@current + 100, @current) == 2201
   end
 
+  test "stats" do
+    before = stats()
+
+    parent = self()
+
+    pid =
+      spawn(fn ->
+        t = TestUtils.new_transaction()
+        FDB.Transaction.get(t, "fdb:stats")
+        assert stats().transactions > before.transactions
+        send(parent, :done)
+      end)
+
+    assert_receive :done
+    ref = Process.monitor(pid)
+    assert_receive {:DOWN, ^ref, _, _, _}
+    :erlang.garbage_collect()
+
+    now = stats()
+    assert now.transactions_created > before.transactions_created
+    assert now.futures_created > before.futures_created
+    assert now.transactions <= before.transactions
+  end
+
   test "get_error" do
     assert get_error(2202) == "API version not valid"
     assert get_error(2201) == "API version may be set only once"
@@ -0,0 +1,106 @@
+defmodule FDB.QueueTest do
+  use ExUnit.Case, async: false
+  alias FDB.Database
+  alias FDB.Queue
+  import TestUtils
+
+  setup do
+    flushdb()
+  end
+
+  defp push(db, queue, values) do
+    Database.transact(db, fn t -> Queue.push_all(t, queue, values) end)
+  end
+
+  test "claims in order" do
+    db = new_database()
+    queue = Queue.new("queue", %{spread: 1})
+
+    push(db, queue, ["a", "b"])
+    push(db, queue, ["c"])
+    assert Queue.size(db, queue) == 3
+
+    items = Queue.claim(db, queue, 2)
+    assert Enum.map(items, & &1.value) == ["a", "b"]
+    assert Queue.size(db, queue) == 1
+
+    items = Queue.claim(db, queue, 2, %{ack: Enum.map(items, & &1.id)})
+    assert Enum.map(items, & &1.value) == ["c"]
+    :ok = Queue.ack(db, queue, Enum.map(items, & &1.id))
+
+    assert Queue.claim(db, queue, 2) == []
+    assert Queue.requeue_expired(db, Queue.new("queue", %{lease: 0})) == 0
+  end
+
+  test "keeps the items of several pushes in a transaction" do
+    db = new_database()
+    queue = Queue.new("queue", %{spread: 1})
+
+    Database.transact(db, fn t ->
+      :ok = Queue.push(t, queue, "a")
+      :ok = Queue.push_all(t, queue, ["b", "c"])
+      :ok = Queue.push(t, queue, "d")
+    end)
+
+    assert Queue.size(db, queue) == 4
+    assert Enum.map(Queue.claim(db, queue, 4), & &1.value) == ["a", "b", "c", "d"]
+  end
+
+  test "keeps the items pushed from several processes in a transaction" do
+    db = new_database()
+    queue = Queue.new("queue", %{spread: 1})
+
+    Database.transact(db, fn t ->
+      :ok = Queue.push(t, queue, "a")
+      :ok = Task.async(fn -> Queue.push_all(t, queue, ["b", "c"]) end) |> Task.await()
+      :ok = Queue.push(t, queue, "d")
+    end)
+
+    assert Enum.map(Queue.claim(db, queue, 4), & &1.value) == ["a", "b", "c", "d"]
+  end
+
+  test "waits for items" do
+    db = new_database()
+    queue = Queue.new("queue", %{value_coder: FDB.Coder.Integer.new()})
+
+    assert Queue.claim(db, queue, 1, %{timeout: 10}) == []
+
+    task = Task.async(fn -> Queue.claim(db, queue, 1, %{timeout: 5000}) end)
+    Process.sleep(100)
+    push(db, queue, [42])
+
+    assert [%Queue.Item{value: 42}] = Task.await(task)
+  end
+
+  test "requeues expired items" do
+    db = new_database()
+    queue = Queue.new("queue", %{lease: 0})
+
+    push(db, queue, ["a"])
+    [%Queue.Item{id: id}] = Queue.claim(db, queue, 1)
+    Process.sleep(5)
+
+    assert Queue.requeue_expired(db, queue) == 1
+    assert [%Queue.Item{id: ^id, value: "a"}] = Queue.claim(db, queue, 1)
+  end
+
+  test "each item is claimed once" do
+    db = new_database()
+    queue = Queue.new("queue", %{value_coder: FDB.Coder.Integer.new()})
+
+    Enum.each(Enum.chunk_every(1..200, 10), &push(db, queue, &1))
+
+    values =
+      1..4
+      |> Enum.map(fn _ ->
+        Task.async(fn ->
+          Queue.stream(db, queue, %{batch_size: 10, timeout: 100})
+          |> Enum.take(50)
+          |> Enum.map(& &1.value)
+        end)
+      end)
+      |> Enum.flat_map(&Task.await(&1, 30_000))
+
+    assert Enum.sort(values) == Enum.to_list(1..200)
+  end
+end
@@ -0,0 +1,80 @@
+defmodule FDB.RangeJobTest do
+  use ExUnit.Case, async: false
+  alias FDB.Database
+  alias FDB.Transaction
+  alias FDB.KeyRange
+  alias FDB.KeySelectorRange
+  alias FDB.RangeJob
+  import TestUtils
+
+  setup do
+    flushdb()
+  end
+
+  @keys for i <- 1..500, do: "fdb:" <> String.pad_leading(Integer.to_string(i), 3, "0")
+  @options %{chunk_size: 1000, transaction_bytes: 2000, concurrency: 4}
+
+  defp load(db) do
+    Enum.chunk_every(@keys, 100)
+    |> Enum.each(fn keys ->
+      Database.transact(db, fn t ->
+        Enum.each(keys, &Transaction.set(t, &1, "value of " <> &1))
+      end)
+    end)
+  end
+
+  defp upcase(t, key, value), do: Transaction.set(t, key, String.upcase(value))
+
+  defp values(db) do
+    Database.get_range_stream(db, KeySelectorRange.starts_with("fdb:"))
+    |> Enum.map(fn {_key, value} -> value end)
+  end
+
+  test "rewrites the range" do
+    db = new_database()
+    load(db)
+
+    assert RangeJob.status(db, "upcase") == nil
+    assert RangeJob.run(db, "upcase", KeyRange.starts_with("fdb:"), &upcase/3, @options) == :ok
+    assert values(db) == Enum.map(@keys, &("VALUE OF " <> String.upcase(&1)))
+
+    assert %{chunks: chunks, done: chunks, processed: 500} = RangeJob.status(db, "upcase")
+
+    # a finished job doesn't run again
+    assert RangeJob.run(db, "upcase", KeyRange.starts_with("fdb:"), fn _, _, _ -> flunk() end) ==
+             :ok
+
+    :ok = RangeJob.reset(db, "upcase")
+    assert RangeJob.status(db, "upcase") == nil
+  end
+
+  test "resumes after a crash" do
+    db = new_database()
+    load(db)
+    range = KeyRange.starts_with("fdb:")
+    options = Map.put(@options, :concurrency, 1)
+
+    failing = fn t, key, value ->
+      if key == "fdb:250", do: raise("crash")
+      upcase(t, key, value)
+    end
+
+    {pid, ref} = spawn_monitor(fn -> RangeJob.run(db, "upcase", range, failing, options) end)
+    assert_receive {:DOWN, ^ref, :process, ^pid, _}, 5000
+
+    %{processed: processed} = RangeJob.status(db, "upcase")
+    assert processed > 0 && processed < 250
+
+    calls = :counters.new(1, [])
+
+    counting = fn t, key, value ->
+      :counters.add(calls, 1, 1)
+      upcase(t, key, value)
+    end
+
+    assert RangeJob.run(db, "upcase", range, counting, options) == :ok
+    assert :counters.get(calls, 1) == 500 - processed
+    assert %{processed: 500} = RangeJob.status(db, "upcase")
+    assert values(db) == Enum.map(@keys, &("VALUE OF " <> String.upcase(&1)))
+  end
+end
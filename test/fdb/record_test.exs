@@ -0,0 +1,128 @@
+defmodule FDB.RecordTest do
+  use ExUnit.Case, async: false
+  alias FDB.Database
+  alias FDB.Transaction
+  alias FDB.KeySelectorRange
+  alias FDB.Record
+  alias FDB.Coder
+  import TestUtils
+
+  setup do
+    flushdb()
+  end
+
+  defp users(indexes) do
+    Record.new("users", %{
+      primary_key: Coder.Integer.new(),
+      value_coder: Coder.Tuple.new({Coder.UnicodeString.new(), Coder.Integer.new()}),
+      indexes: indexes
+    })
+  end
+
+  defp index_size(db, users, name) do
+    Database.transact(db, fn t ->
+      Transaction.get_range_stream(t, KeySelectorRange.starts_with(nil), %{
+        coder: users.indexes[name].coder
+      })
+      |> Enum.count()
+    end)
+  end
+
+  test "indexes are maintained on write" do
+    db = new_database()
+
+    users =
+      users(%{
+        name: %{key: 0, coder: Coder.UnicodeString.new()},
+        age: %{key: fn {_name, age} -> age end, coder: Coder.Integer.new()}
+      })
+
+    Database.transact(db, fn t ->
+      :ok = Record.put(t, users, 1, {"alice", 30})
+      :ok = Record.put(t, users, 2, {"bob", 25})
+      :ok = Record.put(t, users, 3, {"carol", 30})
+    end)
+
+    Database.transact(db, fn t ->
+      assert Record.get(t, users, 2) == {"bob", 25}
+      assert Record.query(t, users, :name, "alice") == [{1, {"alice", 30}}]
+      assert Record.query(t, users, :age, 30) == [{1, {"alice", 30}}, {3, {"carol", 30}}]
+      assert Record.query(t, users, :age, 30, %{limit: 1}) == [{1, {"alice", 30}}]
+      assert Record.query_range(t, users, :age, 20, 30) == [{2, {"bob", 25}}]
+      assert length(Record.query_range(t, users, :age, 25, 31)) == 3
+    end)
+
+    Database.transact(db, fn t ->
+      :ok = Record.put(t, users, 1, {"alice", 31})
+      :ok = Record.delete(t, users, 3)
+      :ok = Record.delete(t, users, 4)
+    end)
+
+    Database.transact(db, fn t ->
+      assert Record.query(t, users, :age, 30) == []
+      assert Record.query(t, users, :age, 31) == [{1, {"alice", 31}}]
+      assert Record.query(t, users, :name, "carol") == []
+    end)
+
+    assert index_size(db, users, :name) == 2
+    assert index_size(db, users, :age) == 2
+
+    assert_raise ArgumentError, fn ->
+      Database.transact(db, fn t -> Record.query(t, users, :email, "x") end)
+    end
+  end
+
+  test "build index" do
+    db = new_database()
+    users = users(%{})
+
+    Database.transact(db, fn t ->
+      Enum.each(1..10, &Record.put(t, users, &1, {"user#{&1}", rem(&1, 3)}))
+    end)
+
+    users = users(%{age: %{key: 1, coder: Coder.Integer.new()}})
+    :ok = Record.build_index(db, users, :age, 3)
+
+    Database.transact(db, fn t ->
+      assert Enum.map(Record.query(t, users, :age, 0), &elem(&1, 0)) == [3, 6, 9]
+    end)
+  end
+
+  test "build index with concurrent writes" do
+    db = new_database()
+    users = users(%{})
+
+    Database.transact(db, fn t ->
+      Enum.each(1..200, &Record.put(t, users, &1, {"user#{&1}", 0}))
+    end)
+
+    users = users(%{age: %{key: 1, coder: Coder.Integer.new()}})
+
+    writer =
+      Task.async(fn ->
+        Enum.each(1..200, fn i ->
+          Database.transact(db, fn t -> Record.put(t, users, 201 - i, {"user", i}) end)
+        end)
+      end)
+
+    :ok = Record.build_index(db, users, :age, 5)
+    Task.await(writer, 30_000)
+
+    Database.transact(db, fn t ->
+      records =
+        Transaction.get_range_stream(t, KeySelectorRange.starts_with(nil), %{
+          coder: users.records
+        })
+        |> Enum.map(fn {primary_key, {_name, age}} -> {age, primary_key} end)
+        |> Enum.sort()
+
+      entries =
+        Transaction.get_range_stream(t, KeySelectorRange.starts_with(nil), %{
+          coder: users.indexes[:age].coder
+        })
+        |> Enum.map(fn {entry, _} -> entry end)
+
+      assert entries == records
+    end)
+  end
+end
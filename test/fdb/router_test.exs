@@ -0,0 +1,116 @@
+defmodule FDB.RouterTest do
+  use ExUnit.Case, async: false
+  alias FDB.Database
+  alias FDB.Transaction
+  alias FDB.KeySelector
+  alias FDB.KeySelectorRange
+  alias FDB.Router
+  alias FDB.Coder.{Subspace, Identity}
+  import TestUtils
+
+  setup do
+    flushdb()
+  end
+
+  # Uses a second cluster if FDB_CLUSTER_FILE_2 is set (see `make
+  # start-second-server`), otherwise two disjoint subspaces of the
+  # same cluster stand in for the clusters.
+  defp databases do
+    case System.get_env("FDB_CLUSTER_FILE_2") do
+      nil ->
+        Enum.map(["a", "b"], fn prefix ->
+          Database.set_defaults(new_database(), %{
+            coder: Transaction.Coder.new(Subspace.new(prefix), Identity.new())
+          })
+        end)
+
+      path ->
+        second = Database.create(path)
+
+        Database.transact(second, fn t ->
+          Transaction.clear_range(t, FDB.KeyRange.range("", "\xff"))
+        end)
+
+        [new_database(), second]
+    end
+  end
+
+  defp load(router, keys) do
+    Enum.each(keys, fn key ->
+      Router.transact(router, key, fn t -> Transaction.set(t, key, "v" <> key) end)
+    end)
+  end
+
+  @keys for i <- 1..40, do: "k" <> String.pad_leading(Integer.to_string(i), 2, "0")
+
+  test "range partitioning" do
+    [a, b] = databases()
+    router = Router.ranges([{"", a}, {"k20", b}], %{coder: Transaction.Coder.new()})
+    load(router, @keys)
+
+    assert Router.database(router, "k19") == a
+    assert Router.database(router, "k20") == b
+
+    all = Enum.map(@keys, &{&1, "v" <> &1})
+    range = KeySelectorRange.starts_with("k")
+
+    assert Router.get_range_stream(router, range) |> Enum.to_list() == all
+    assert Router.get_range_stream(router, range, %{reverse: true}) |> Enum.to_list() ==
+             Enum.reverse(all)
+
+    assert Router.get_range_stream(router, range, %{limit: 25}) |> Enum.to_list() ==
+             Enum.take(all, 25)
+
+    assert Router.get_range_stream(router, KeySelectorRange.starts_with("k3"))
+           |> Enum.to_list() == Enum.slice(all, 29, 11)
+  end
+
+  test "range ending on a shard boundary" do
+    [a, b] = databases()
+    router = Router.ranges([{"", a}, {"k20", b}], %{coder: Transaction.Coder.new()})
+    load(router, @keys)
+    all = Enum.map(@keys, &{&1, "v" <> &1})
+
+    range =
+      KeySelectorRange.range(
+        KeySelector.first_greater_or_equal("k10"),
+        KeySelector.first_greater_or_equal("k20")
+      )
+
+    assert Router.databases(router, range) == [a]
+    assert Router.get_range_stream(router, range) |> Enum.to_list() == Enum.slice(all, 9, 10)
+
+    range =
+      KeySelectorRange.range(
+        KeySelector.first_greater_or_equal("k10"),
+        KeySelector.first_greater_than("k20")
+      )
+
+    assert Router.databases(router, range) == [a, b]
+    assert Router.get_range_stream(router, range) |> Enum.to_list() == Enum.slice(all, 9, 11)
+  end
+
+  test "hash partitioning" do
+    [a, b] = databases()
+    router = Router.hash([a, b], %{coder: Transaction.Coder.new()})
+    load(router, @keys)
+
+    all = Enum.map(@keys, &{&1, "v" <> &1})
+    range = KeySelectorRange.starts_with("k")
+
+    assert Router.get_range_stream(router, range) |> Enum.to_list() == all
+    assert Router.get_range_stream(router, range, %{reverse: true}) |> Enum.to_list() ==
+             Enum.reverse(all)
+
+    assert Router.get_range_stream(router, range, %{limit: 5}) |> Enum.to_list() ==
+             Enum.take(all, 5)
+
+    counts =
+      Enum.map([a, b], fn db ->
+        Database.get_range_stream(db, KeySelectorRange.starts_with(nil)) |> Enum.count()
+      end)
+
+    assert Enum.sum(counts) == 40
+    assert Enum.all?(counts, &(&1 > 0))
+  end
+end
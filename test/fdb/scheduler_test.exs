@@ -0,0 +1,155 @@
+defmodule FDB.SchedulerTest do
+  use ExUnit.Case, async: false
+  alias FDB.Transaction
+  alias FDB.Scheduler
+  import TestUtils
+
+  setup do
+    flushdb()
+  end
+
+  # blocks the transaction till the test process sends :go
+  defp block(test) do
+    send(test, {:started, self()})
+
+    receive do
+      :go -> :ok
+    end
+  end
+
+  defp go do
+    assert_receive {:started, pid}, 5000
+    send(pid, :go)
+  end
+
+  test "limits concurrency per class" do
+    db = new_database()
+
+    {:ok, scheduler} =
+      Scheduler.start_link(
+        classes: %{
+          batch: %{priority: :batch, tags: ["test"], max_concurrency: 2},
+          immediate: %{priority: :immediate}
+        }
+      )
+
+    # the acquire calls are traced to know when they are queued
+    :erlang.trace(scheduler, true, [:receive])
+    test = self()
+    running = :counters.new(2, [])
+
+    tasks =
+      Enum.map(1..6, fn i ->
+        Task.async(fn ->
+          Scheduler.transact(scheduler, db, :batch, fn t ->
+            :counters.add(running, 1, 1)
+            :counters.put(running, 2, max(:counters.get(running, 2), :counters.get(running, 1)))
+            block(test)
+            :counters.sub(running, 1, 1)
+            Transaction.set(t, "fdb:#{i}", "value")
+          end)
+        end)
+      end)
+
+    Enum.each(1..6, fn _ ->
+      assert_receive {:trace, ^scheduler, :receive, {:"$gen_call", _, {:acquire, :batch}}}
+    end)
+
+    :erlang.trace(scheduler, false, [:receive])
+    assert %{batch: %{running: 2, queued: 4}} = Scheduler.stats(scheduler)
+
+    assert Scheduler.transact(scheduler, db, :immediate, fn t ->
+             Transaction.get(t, "fdb:missing")
+           end) == nil
+
+    Enum.each(1..6, fn _ -> go() end)
+    Enum.each(tasks, &Task.await/1)
+    assert :counters.get(running, 2) == 2
+    assert %{batch: %{running: 0, queued: 0}} = Scheduler.stats(scheduler)
+
+    assert_raise ArgumentError, fn ->
+      Scheduler.transact(scheduler, db, :unknown, fn _ -> :ok end)
+    end
+  end
+
+  test "rejects when the queue is full" do
+    db = new_database()
+
+    {:ok, scheduler} =
+      Scheduler.start_link(classes: %{default: %{max_concurrency: 1, max_queue: 0}})
+
+    test = self()
+
+    task =
+      Task.async(fn -> Scheduler.transact(scheduler, db, :default, fn _ -> block(test) end) end)
+
+    assert_receive {:started, _}, 5000
+
+    assert_raise FDB.OverloadError, fn ->
+      Scheduler.transact(scheduler, db, :default, fn _ -> :ok end)
+    end
+
+    send(task.pid, :go)
+    Task.await(task)
+  end
+
+  test "adapts the limit to the commit latency" do
+    db = new_database()
+
+    {:ok, scheduler} =
+      Scheduler.start_link(
+        target_latency: 0,
+        classes: %{default: %{min_concurrency: 2, max_concurrency: 10}}
+      )
+
+    Enum.each(1..10, fn i ->
+      Scheduler.transact(scheduler, db, :default, fn t -> Transaction.set(t, "fdb:#{i}", "") end)
+    end)
+
+    assert %{default: %{limit: 2}} = Scheduler.stats(scheduler)
+
+    # a crashed caller releases its slot
+    {pid, ref} =
+      spawn_monitor(fn ->
+        Scheduler.transact(scheduler, db, :default, fn _ -> exit(:kill) end)
+      end)
+
+    assert_receive {:DOWN, ^ref, :process, ^pid, _}
+    assert %{default: %{running: 0}} = Scheduler.stats(scheduler)
+  end
+
+  test "decreases the limit at most once per interval" do
+    db = new_database()
+
+    {:ok, scheduler} =
+      Scheduler.start_link(
+        target_latency: 0,
+        decrease_interval: 60_000,
+        classes: %{default: %{min_concurrency: 2, max_concurrency: 10}}
+      )
+
+    Enum.each(1..10, fn i ->
+      Scheduler.transact(scheduler, db, :default, fn t -> Transaction.set(t, "fdb:#{i}", "") end)
+    end)
+
+    assert %{default: %{limit: 7}} = Scheduler.stats(scheduler)
+  end
+
+  test "releases the slot of a killed caller" do
+    db = new_database()
+
+    {:ok, scheduler} =
+      Scheduler.start_link(classes: %{default: %{min_concurrency: 1, max_concurrency: 1}})
+
+    test = self()
+    pid = spawn(fn -> Scheduler.transact(scheduler, db, :default, fn _ -> block(test) end) end)
+    assert_receive {:started, ^pid}, 5000
+    assert %{default: %{running: 1}} = Scheduler.stats(scheduler)
+
+    Process.exit(pid, :kill)
+
+    # admitted only once the :DOWN of the killed caller is handled
+    assert Scheduler.transact(scheduler, db, :default, fn _ -> :ok end) == :ok
+    assert %{default: %{running: 0, queued: 0}} = Scheduler.stats(scheduler)
+  end
+end
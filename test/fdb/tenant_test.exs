@@ -0,0 +1,57 @@
+defmodule FDB.TenantTest do
+  use ExUnit.Case, async: false
+  alias FDB.Database
+  alias FDB.Transaction
+  alias FDB.KeyRange
+  alias FDB.KeySelectorRange
+  alias FDB.Tenant
+  alias FDB.Coder.{Tuple, ByteString, Integer}
+  import TestUtils
+
+  # needs a cluster with tenant mode, refer FDB.Tenant
+  @moduletag :tenant
+
+  setup do
+    flushdb()
+    db = new_database()
+
+    Enum.each(["fdb_a", "fdb_b"], fn name ->
+      try do
+        Database.transact(Tenant.open(db, name), fn t ->
+          Transaction.clear_range(t, KeyRange.range("", "\xff"))
+        end)
+
+        :ok = Tenant.delete(db, name)
+      rescue
+        # tenant_not_found
+        e in FDB.Error -> if e.code != 2131, do: reraise(e, __STACKTRACE__)
+      end
+
+      :ok = Tenant.create(db, name)
+    end)
+
+    {:ok, db: db}
+  end
+
+  test "isolates the keys of each tenant", %{db: db} do
+    coder = Transaction.Coder.new(Tuple.new({ByteString.new(), Integer.new()}))
+    db = Database.set_defaults(db, %{coder: coder})
+    a = Tenant.open(db, "fdb_a")
+    b = Tenant.open(db, "fdb_b")
+
+    Database.transact(a, fn t -> Transaction.set(t, {"user", 1}, "alice") end)
+    Database.transact(b, fn t -> Transaction.set(t, {"user", 1}, "bob") end)
+
+    assert Database.transact(a, &Transaction.get(&1, {"user", 1})) == "alice"
+    assert Database.transact(b, &Transaction.get(&1, {"user", 1})) == "bob"
+    assert Database.transact(db, &Transaction.get(&1, {"user", 1})) == nil
+
+    assert Transaction.get_range_stream(a, KeySelectorRange.starts_with({"user"}))
+           |> Enum.to_list() == [{{"user", 1}, "alice"}]
+
+    t = Transaction.create(b, %{snapshot: true})
+    assert t.coder == coder
+    assert Transaction.get(t, {"user", 1}) == "bob"
+    assert FDB.stats().tenants >= 2
+  end
+end
@@ -0,0 +1,111 @@
+defmodule FDB.TimeSeriesTest do
+  use ExUnit.Case, async: false
+  alias FDB.Database
+  alias FDB.TimeSeries
+  import TestUtils
+
+  setup do
+    flushdb()
+  end
+
+  @points for t <- 0..5000, rem(t, 3) == 0, do: {t, rem(t * 7, 101) - 50}
+
+  defp expected(points, from, to) do
+    values = for {t, v} <- points, t >= from && t < to, do: v
+
+    %{
+      count: length(values),
+      sum: Enum.sum(values),
+      min: if(values == [], do: nil, else: Enum.min(values)),
+      max: if(values == [], do: nil, else: Enum.max(values))
+    }
+  end
+
+  test "plan" do
+    assert TimeSeries.plan(5, 2345, [1000, 100, 10]) == [
+             {:points, 5, 10},
+             {10, 10, 100},
+             {100, 100, 1000},
+             {1000, 1000, 2000},
+             {100, 2000, 2300},
+             {10, 2300, 2340},
+             {:points, 2340, 2345}
+           ]
+
+    assert TimeSeries.plan(-15, 15, [10]) ==
+             [{:points, -15, -10}, {10, -10, 10}, {:points, 10, 15}]
+    assert TimeSeries.plan(3, 7, [10]) == [{:points, 3, 7}]
+    assert TimeSeries.plan(7, 7, [10]) == []
+  end
+
+  test "aggregate" do
+    db = new_database()
+    ts = TimeSeries.new("fdb_ts", %{resolutions: [10, 100, 1000]})
+
+    @points
+    |> Enum.chunk_every(100)
+    |> Enum.each(fn points ->
+      Database.transact(db, fn t -> TimeSeries.add_all(t, ts, "cpu", points) end)
+    end)
+
+    Database.transact(db, fn t -> TimeSeries.add(t, ts, "other", 50, 1_000_000) end)
+
+    Database.transact(db, fn t ->
+      Enum.each([{0, 5001}, {5, 2345}, {1, 2}, {999, 1001}, {4000, 9000}, {-100, 0}], fn
+        {from, to} ->
+          assert TimeSeries.aggregate(t, ts, "cpu", from, to) == expected(@points, from, to)
+      end)
+
+      assert TimeSeries.aggregate(t, ts, "other", 0, 100) == %{
+               count: 1,
+               sum: 1_000_000,
+               min: 1_000_000,
+               max: 1_000_000
+             }
+
+      buckets = TimeSeries.buckets(t, ts, "cpu", 1000, 0, 3000)
+      assert Enum.map(buckets, &elem(&1, 0)) == [0, 1000, 2000]
+
+      Enum.each(buckets, fn {start, aggregate} ->
+        assert aggregate == expected(@points, start, start + 1000)
+      end)
+
+      assert_raise ArgumentError, fn -> TimeSeries.buckets(t, ts, "cpu", 60, 0, 3000) end
+
+      :ok = TimeSeries.clear(t, ts, "cpu")
+      assert TimeSeries.aggregate(t, ts, "cpu", 0, 5001) == expected([], 0, 1)
+      assert TimeSeries.aggregate(t, ts, "other", 0, 100).count == 1
+    end)
+  end
+
+  test "keeps the points of several calls in a transaction" do
+    db = new_database()
+    ts = TimeSeries.new("fdb_ts", %{resolutions: [10]})
+
+    Database.transact(db, fn t ->
+      :ok = TimeSeries.add(t, ts, "cpu", 5, 1)
+      :ok = TimeSeries.add_all(t, ts, "cpu", [{5, 2}, {6, 3}])
+      :ok = TimeSeries.add(t, ts, "cpu", 5, 4)
+    end)
+
+    Database.transact(db, fn t ->
+      assert TimeSeries.aggregate(t, ts, "cpu", 5, 6) == %{count: 3, sum: 7, min: 1, max: 4}
+      assert TimeSeries.aggregate(t, ts, "cpu", 0, 10) == %{count: 4, sum: 10, min: 1, max: 4}
+    end)
+  end
+
+  test "keeps the points added from several processes in a transaction" do
+    db = new_database()
+    ts = TimeSeries.new("fdb_ts", %{resolutions: [10]})
+
+    Database.transact(db, fn t ->
+      :ok = TimeSeries.add_all(t, ts, "cpu", [{5, 1}, {5, 2}])
+      task = Task.async(fn -> TimeSeries.add_all(t, ts, "cpu", [{5, 3}, {5, 4}]) end)
+      :ok = Task.await(task)
+    end)
+
+    Database.transact(db, fn t ->
+      assert TimeSeries.aggregate(t, ts, "cpu", 5, 6) == %{count: 4, sum: 10, min: 1, max: 4}
+    end)
+  end
+end
@@ -200,6 +200,37 @@ defmodule FDBTest do
     assert actual == Enum.take(expected, 10) |> Enum.reverse()
   end
 
+  test "range snapshot stream" do
+    d = new_database()
+
+    expected =
+      Database.transact(d, fn t ->
+        Enum.map(1..100, fn i ->
+          key = "fdb:" <> String.pad_leading(Integer.to_string(i), 3, "0")
+          value = random_value(100)
+          Transaction.set(t, key, value)
+          {key, value}
+        end)
+      end)
+
+    batches =
+      Database.get_range_snapshot_stream(d, KeySelectorRange.starts_with("fdb:"), %{
+        target_bytes: 1000
+      })
+      |> Enum.map(fn batch ->
+        Database.transact(d, fn t ->
+          Transaction.set(t, "fdb:050", "changed")
+          Transaction.set(t, "fdb:101", "added")
+        end)
+
+        batch
+      end)
+
+    assert length(batches) > 1
+    assert [_] = Enum.uniq(Enum.map(batches, fn {read_version, _} -> read_version end))
+    assert Enum.flat_map(batches, fn {_, key_values} -> key_values end) == expected
+  end
+
   test "atomic_op" do
     t = new_transaction()
     Transaction.set(t, "fdb:counter", <<0::little-integer-unsigned-size(64)>>)
@@ -421,6 +452,19 @@ defmodule FDBTest do
     assert_raise FDB.Error, ~r/read-only/, fn -> Future.await(future) end
   end
 
+  test "versionstamp requested twice" do
+    db = new_database()
+
+    {first, second} =
+      Database.transact(db, fn t ->
+        first = Transaction.get_versionstamp_q(t)
+        assert Transaction.set(t, random_key(), random_value()) == :ok
+        {first, Transaction.get_versionstamp_q(t)}
+      end)
+
+    assert Future.await(first) == Future.await(second)
+  end
+
   test "versionstamped key" do
     coder =
       FDB.Transaction.Coder.new(
@@ -613,6 +657,43 @@ defmodule FDBTest do
     end)
   end
 
+  test "get_mapped_range" do
+    db = new_database()
+    string = Coder.UnicodeString.new()
+    integer = Coder.Integer.new()
+    index = Transaction.Coder.new(Coder.Tuple.new({string, string, integer}))
+    records = Transaction.Coder.new(Coder.Tuple.new({string, integer, string}))
+    mapper = {{"record", "{K[2]}", "{...}"}, Coder.Tuple.new({string, string, string})}
+
+    Database.transact(db, fn t ->
+      Enum.each([{1, "alice"}, {2, "bob"}, {3, "alice"}], fn {id, name} ->
+        Transaction.set(t, {"index", name, id}, "", %{coder: index})
+        Transaction.set(t, {"record", id, "name"}, name, %{coder: records})
+        Transaction.set(t, {"record", id, "score"}, to_string(id * 10), %{coder: records})
+      end)
+    end)
+
+    Database.transact(db, fn t ->
+      Transaction.set_option(t, transaction_option_read_your_writes_disable())
+
+      range = KeySelectorRange.starts_with({"index", "alice"})
+
+      result =
+        Transaction.get_mapped_range(t, range, mapper, %{
+          coder: index,
+          mapped_coder: records,
+          snapshot: true
+        })
+
+      assert result.key_values == [
+               {{"index", "alice", 1}, "",
+                [{{"record", 1, "name"}, "alice"}, {{"record", 1, "score"}, "10"}]},
+               {{"index", "alice", 3}, "",
+                [{{"record", 3, "name"}, "alice"}, {{"record", 3, "score"}, "30"}]}
+             ]
+    end)
+  end
+
   test "metadata version" do
     db = new_database()
 
@@ -1,5 +1,5 @@
 :ok = FDB.start()
-ExUnit.start(exclude: [:integration], capture_log: true)
+ExUnit.start(exclude: [:integration, :tenant], capture_log: true)
 
 System.at_exit(fn _exit_code ->
   :ok = FDB.Network.stop()